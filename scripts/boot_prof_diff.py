@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+## SPDX-License-Identifier: Apache-2.0
+## Copyright (c) Bao Project and Contributors. All rights reserved.
+
+"""
+Compares two boot profiles printed by a hypervisor built with BOOT_PROF=y.
+
+Each profile is a console log containing the BOOTPROF table lines. Other lines are ignored, so the
+full console output can be given as is. For each phase, it reports the slowest CPU of each VM and
+the difference between the two profiles. Times are shown in microseconds when the timer frequency
+is known, either from the log or from --freq, and in timer ticks otherwise.
+"""
+
+import argparse
+import sys
+
+
+def parse_profile(path):
+    freq = 0
+    rows = {}
+    order = []
+    with open(path, errors="replace") as log:
+        for line in log:
+            fields = line.strip().split("\t")
+            if len(fields) < 2 or fields[0] != "BOOTPROF":
+                continue
+            if fields[1] == "freq":
+                freq = int(fields[2])
+                continue
+            if fields[1] == "vm" or len(fields) != 7:
+                continue
+            vm, cpu, phase = int(fields[1]), int(fields[2]), fields[3]
+            start, ticks, count = int(fields[4]), int(fields[5]), int(fields[6])
+            key = (vm, phase)
+            if key not in rows:
+                rows[key] = {}
+                order.append(key)
+            rows[key][cpu] = (start, ticks, count)
+    return freq, rows, order
+
+
+def slowest(phase, cpus):
+    """
+    Returns the cpu that took the longest in a phase and its value for the phase. For entry, that
+    is the start offset, for every other phase (including vcpu_run, whose ticks are the time since
+    entry) it is the tick count.
+    """
+    field = 0 if phase == "entry" else 1
+    cpu = max(cpus, key=lambda c: cpus[c][field])
+    return cpu, cpus[cpu][field]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("base", help="console log of the baseline boot")
+    parser.add_argument("new", help="console log of the boot to compare")
+    parser.add_argument("--freq", type=int, default=0,
+                        help="timer frequency in Hz, if not reported in the logs")
+    args = parser.parse_args()
+
+    base_freq, base, base_order = parse_profile(args.base)
+    new_freq, new, new_order = parse_profile(args.new)
+    if not base or not new:
+        sys.exit("no BOOTPROF table found in {}".format(args.base if not base else args.new))
+
+    freq = args.freq or base_freq or new_freq
+    if base_freq and new_freq and base_freq != new_freq and not args.freq:
+        print("warning: logs report different timer frequencies, using {} Hz".format(freq),
+              file=sys.stderr)
+    unit = "us" if freq else "ticks"
+
+    def fmt(ticks):
+        return "{:.1f}".format(ticks * 1e6 / freq) if freq else str(ticks)
+
+    header = ("vm", "phase", "cpu", "base " + unit, "new " + unit, "delta " + unit, "delta %")
+    table = []
+    for key in base_order + [k for k in new_order if k not in base]:
+        vm, phase = key
+        b_cpu, b_val = slowest(phase, base[key]) if key in base else ("-", None)
+        n_cpu, n_val = slowest(phase, new[key]) if key in new else ("-", None)
+        delta = (n_val - b_val) if (b_val is not None and n_val is not None) else None
+        table.append((
+            str(vm),
+            phase,
+            "{}/{}".format(b_cpu, n_cpu),
+            fmt(b_val) if b_val is not None else "-",
+            fmt(n_val) if n_val is not None else "-",
+            ("+" if delta > 0 else "") + fmt(delta) if delta is not None else "-",
+            "{:+.1f}".format(100.0 * delta / b_val) if (delta is not None and b_val) else "-",
+        ))
+
+    widths = [max(len(row[i]) for row in [header] + table) for i in range(len(header))]
+    for row in [header] + table:
+        print("  ".join(col.ljust(w) if i < 3 else col.rjust(w)
+                        for i, (col, w) in enumerate(zip(row, widths))))
+
+
+if __name__ == "__main__":
+    main()
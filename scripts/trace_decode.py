@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+## SPDX-License-Identifier: Apache-2.0
+## Copyright (c) Bao Project and Contributors. All rights reserved.
+
+"""
+Decodes a dump of the trace shared memory of a hypervisor built with TRACE=y into a Chrome trace
+JSON file, which can be opened in chrome://tracing or in Perfetto. Each cpu is shown as a thread.
+VM exits are shown as slices spanning their handling time and every other event as an instant.
+The layout of the dump is described in src/core/inc/trace.h.
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+TRACE_MAGIC = 0x43525442
+TRACE_VERSION = 1
+
+HDR = struct.Struct("<IIQII40x")
+RING_HDR = struct.Struct("<Q56x")
+EVENT = struct.Struct("<QIIQ")
+
+EVENTS = [
+    ("vm_exit", ("reason", "ticks")),
+    ("irq_inject", ("irq", "vcpu")),
+    ("lr_spill", ("irq", "lr")),
+    ("lr_refill", ("irq", "lr")),
+    ("msg_send", ("target_cpu", "handler_event")),
+    ("msg_recv", ("handler", "event")),
+    ("tlb_inv", ("as", "addr")),
+    ("page_alloc", ("num_pages", "base")),
+]
+
+
+def decode_ring(dump, offset, ring_size):
+    """
+    Returns the events still in the ring at offset, oldest first.
+    """
+    (head,) = RING_HDR.unpack_from(dump, offset)
+    num_events = (ring_size - RING_HDR.size) // EVENT.size
+    first = max(0, head - num_events)
+    events = []
+    for i in range(first, head):
+        pos = offset + RING_HDR.size + (i % num_events) * EVENT.size
+        events.append(EVENT.unpack_from(dump, pos))
+    return events
+
+
+def chrome_event(cpu, event, to_us, ts_base):
+    ts, event_id, arg0, arg1 = event
+    name, arg_names = EVENTS[event_id] if event_id < len(EVENTS) else ("event_{}".format(event_id),
+                                                                     ("arg0", "arg1"))
+    entry = {
+        "name": name,
+        "pid": 0,
+        "tid": cpu,
+        "ts": to_us(ts - ts_base),
+    }
+    if name == "vm_exit":
+        entry["ph"] = "X"
+        entry["dur"] = to_us(arg1)
+        entry["args"] = {arg_names[0]: hex(arg0)}
+    else:
+        entry["ph"] = "i"
+        entry["s"] = "t"
+        entry["args"] = {arg_names[0]: arg0, arg_names[1]: hex(arg1)}
+    return entry
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("dump", help="binary dump of the trace shared memory")
+    parser.add_argument("output", help="chrome trace json file to write")
+    parser.add_argument("--freq", type=int, default=0,
+                        help="timer frequency in Hz, if not reported in the dump")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as dump_file:
+        dump = dump_file.read()
+
+    if len(dump) < HDR.size:
+        sys.exit("dump too small to hold a trace header")
+    magic, version, freq, cpu_num, ring_size = HDR.unpack_from(dump, 0)
+    if magic != TRACE_MAGIC or version != TRACE_VERSION:
+        sys.exit("not a trace dump, or unsupported trace version")
+    if len(dump) < HDR.size + cpu_num * ring_size:
+        sys.exit("dump truncated, expected {} bytes".format(HDR.size + cpu_num * ring_size))
+
+    freq = args.freq or freq
+
+    def to_us(ticks):
+        return ticks * 1e6 / freq if freq else ticks
+
+    if not freq:
+        print("warning: timer frequency unknown, timestamps are in ticks", file=sys.stderr)
+
+    rings = [decode_ring(dump, HDR.size + cpu * ring_size, ring_size) for cpu in range(cpu_num)]
+    timestamps = [event[0] for ring in rings for event in ring]
+    ts_base = min(timestamps) if timestamps else 0
+
+    trace = [{"name": "thread_name", "ph": "M", "pid": 0, "tid": cpu,
+              "args": {"name": "cpu{}".format(cpu)}} for cpu in range(cpu_num)]
+    for cpu, ring in enumerate(rings):
+        trace.extend(chrome_event(cpu, event, to_us, ts_base) for event in ring)
+
+    with open(args.output, "w") as output:
+        json.dump({"traceEvents": trace, "displayTimeUnit": "ns"}, output)
+
+
+if __name__ == "__main__":
+    main()
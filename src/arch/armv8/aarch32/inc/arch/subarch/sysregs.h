@@ -76,6 +76,16 @@ SYSREG_GEN_ACCESSORS_64(cntvoff_el2, 4, c14)
 SYSREG_GEN_ACCESSORS(sctlr_el1, 0, c1, c0, 0)
 SYSREG_GEN_ACCESSORS(cntkctl_el1, 0, c14, c1, 0)
 SYSREG_GEN_ACCESSORS(pmcr_el0, 0, c9, c12, 0)
+SYSREG_GEN_ACCESSORS(pmcntenset_el0, 0, c9, c12, 1)
+SYSREG_GEN_ACCESSORS(pmovsclr_el0, 0, c9, c12, 3)
+SYSREG_GEN_ACCESSORS(pmselr_el0, 0, c9, c12, 5)
+SYSREG_GEN_ACCESSORS(pmxevtyper_el0, 0, c9, c13, 1)
+SYSREG_GEN_ACCESSORS(pmxevcntr_el0, 0, c9, c13, 2)
+SYSREG_GEN_ACCESSORS(pmintenset_el1, 0, c9, c14, 1)
+SYSREG_GEN_ACCESSORS(pmintenclr_el1, 0, c9, c14, 2)
+SYSREG_GEN_ACCESSORS(mdcr_el2, 4, c1, c1, 1)       // hdcr
+SYSREG_GEN_ACCESSORS(cnthp_ctl_el2, 4, c14, c2, 1) // cnthp_ctl
+SYSREG_GEN_ACCESSORS_64(cnthp_cval_el2, 6, c14)    // cnthp_cval
 SYSREG_GEN_ACCESSORS_64(par_el1, 0, c7)
 SYSREG_GEN_ACCESSORS(tcr_el2, 4, c2, c0, 2)    // htcr
 SYSREG_GEN_ACCESSORS_64(ttbr0_el2, 4, c2)      // httbr
@@ -92,6 +102,7 @@ SYSREG_GEN_ACCESSORS(hcr, 4, c1, c1, 0)
 SYSREG_GEN_ACCESSORS(hcr2, 4, c6, c0, 0)
 SYSREG_GEN_ACCESSORS_MERGE(hcr_el2, hcr, hcr2)
 SYSREG_GEN_ACCESSORS(cntfrq_el0, 0, c14, c0, 0)
+SYSREG_GEN_ACCESSORS_64(cntpct_el0, 0, c14)
 
 SYSREG_GEN_ACCESSORS(mpuir_el2, 4, c0, c0, 4)
 SYSREG_GEN_ACCESSORS(prselr_el2, 4, c6, c2, 1)
@@ -164,6 +175,11 @@ static inline void arm_tlbi_vmalls12e1is(void)
     __asm__ volatile("mcr p15, 0, r0, c8, c7, 0");
 }
 
+static inline void arm_tlbi_vmalle1is(void)
+{
+    __asm__ volatile("mcr p15, 0, r0, c8, c3, 0");
+}
+
 static inline void arm_tlbi_vae2is(vaddr_t vaddr)
 {
     __asm__ volatile("mcr p15, 4, %0, c8, c7, 1" ::"r"(vaddr));
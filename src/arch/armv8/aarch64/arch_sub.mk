@@ -5,7 +5,13 @@ CROSS_COMPILE ?= aarch64-none-elf-
 
 arch-cppflags+=-DAARCH64
 arch-cflags+= -mcmodel=large -mstrict-align
+ifeq ($(CC_IS_GCC),y)
+# Keep atomics inline, we don't link against libgcc's outline helpers
+arch-cflags+= -mno-outline-atomics
+endif
 arch-asflags+=
 arch-ldflags+=
 
+arch_string:=y
+
 clang_arch_target:=aarch64
@@ -75,7 +75,18 @@ SYSREG_GEN_ACCESSORS(cntvoff_el2)
 SYSREG_GEN_ACCESSORS(sctlr_el1)
 SYSREG_GEN_ACCESSORS(cntkctl_el1)
 SYSREG_GEN_ACCESSORS(cntfrq_el0)
+SYSREG_GEN_ACCESSORS(cntpct_el0)
 SYSREG_GEN_ACCESSORS(pmcr_el0)
+SYSREG_GEN_ACCESSORS(pmselr_el0)
+SYSREG_GEN_ACCESSORS(pmxevtyper_el0)
+SYSREG_GEN_ACCESSORS(pmxevcntr_el0)
+SYSREG_GEN_ACCESSORS(pmcntenset_el0)
+SYSREG_GEN_ACCESSORS(pmovsclr_el0)
+SYSREG_GEN_ACCESSORS(pmintenset_el1)
+SYSREG_GEN_ACCESSORS(pmintenclr_el1)
+SYSREG_GEN_ACCESSORS(mdcr_el2)
+SYSREG_GEN_ACCESSORS(cnthp_ctl_el2)
+SYSREG_GEN_ACCESSORS(cnthp_cval_el2)
 SYSREG_GEN_ACCESSORS(par_el1)
 SYSREG_GEN_ACCESSORS(tcr_el2)
 SYSREG_GEN_ACCESSORS(ttbr0_el2)
@@ -85,6 +96,7 @@ SYSREG_GEN_ACCESSORS(hcr_el2)
 SYSREG_GEN_ACCESSORS(vtcr_el2)
 SYSREG_GEN_ACCESSORS(vttbr_el2)
 SYSREG_GEN_ACCESSORS(id_aa64mmfr0_el1)
+SYSREG_GEN_ACCESSORS(id_aa64isar0_el1)
 SYSREG_GEN_ACCESSORS(tpidr_el2)
 SYSREG_GEN_ACCESSORS(vsctlr_el2)
 SYSREG_GEN_ACCESSORS(mpuir_el2)
@@ -148,6 +160,11 @@ static inline void arm_tlbi_vmalls12e1is(void)
     __asm__ volatile("tlbi vmalls12e1is");
 }
 
+static inline void arm_tlbi_vmalle1is(void)
+{
+    __asm__ volatile("tlbi vmalle1is");
+}
+
 static inline void arm_tlbi_vae2is(vaddr_t vaddr)
 {
     __asm__ volatile("tlbi vae2is, %0" ::"r"(vaddr >> 12));
@@ -158,6 +175,18 @@ static inline void arm_tlbi_ipas2e1is(vaddr_t vaddr)
     __asm__ volatile("tlbi ipas2e1is, %0" ::"r"(vaddr >> 12));
 }
 
+/* FEAT_TLBIRANGE operations, encoded as sys so older assemblers accept them */
+
+static inline void arm_tlbi_rvae2is(uint64_t range)
+{
+    __asm__ volatile("sys #4, c8, c2, #1, %0" ::"r"(range));
+}
+
+static inline void arm_tlbi_ripas2e1is(uint64_t range)
+{
+    __asm__ volatile("sys #4, c8, c0, #2, %0" ::"r"(range));
+}
+
 #endif /* |__ASSEMBLER__ */
 
 #endif /* __ARCH_SYSREGS_H__ */
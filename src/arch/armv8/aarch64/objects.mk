@@ -5,3 +5,4 @@ cpu-objs-y+=$(ARCH_SUB)/boot.o
 cpu-objs-y+=$(ARCH_SUB)/exceptions.o
 cpu-objs-y+=$(ARCH_SUB)/vm.o
 cpu-objs-y+=$(ARCH_SUB)/aborts.o
+cpu-objs-$(arch_string)+=$(ARCH_SUB)/string.o
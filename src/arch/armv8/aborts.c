@@ -11,6 +11,7 @@
 #include <emul.h>
 #include <config.h>
 #include <hypercall.h>
+#include <trace.h>
 
 typedef void (*abort_handler_t)(unsigned long, unsigned long, unsigned long, unsigned long);
 
@@ -19,12 +20,21 @@ static void aborts_data_lower(unsigned long iss, unsigned long far, unsigned lon
 {
     UNUSED_ARG(ec);
 
+    unsigned long DSFC = bit_extract(iss, ESR_ISS_DA_DSFC_OFF, ESR_ISS_DA_DSFC_LEN) & (0xf << 2);
+
+    /**
+     * Accesses to not yet populated lazy memory, or writes to shared read-only memory, might come
+     * from any kind of instruction, so we must handle them before requiring a valid syndrome.
+     */
+    if ((DSFC == ESR_ISS_DA_DSFC_TRNSLT || DSFC == ESR_ISS_DA_DSFC_PERMIS) &&
+        vm_mem_fault(cpu()->vcpu->vm, far)) {
+        return;
+    }
+
     if (!(iss & ESR_ISS_DA_ISV_BIT) || (iss & ESR_ISS_DA_FnV_BIT)) {
         ERROR("no information to handle data abort (0x%x)", far);
     }
 
-    unsigned long DSFC = bit_extract(iss, ESR_ISS_DA_DSFC_OFF, ESR_ISS_DA_DSFC_LEN) & (0xf << 2);
-
     if (DSFC != ESR_ISS_DA_DSFC_TRNSLT && DSFC != ESR_ISS_DA_DSFC_PERMIS) {
         ERROR("data abort is not translation fault - cant deal with it");
     }
@@ -53,6 +63,20 @@ static void aborts_data_lower(unsigned long iss, unsigned long far, unsigned lon
     }
 }
 
+static void aborts_ins_lower(unsigned long iss, unsigned long far, unsigned long il,
+    unsigned long ec)
+{
+    UNUSED_ARG(il);
+    UNUSED_ARG(ec);
+
+    /* The instruction fault status code shares the encoding of the data one */
+    unsigned long IFSC = bit_extract(iss, ESR_ISS_DA_DSFC_OFF, ESR_ISS_DA_DSFC_LEN) & (0xf << 2);
+
+    if (IFSC != ESR_ISS_DA_DSFC_TRNSLT || !vm_mem_fault(cpu()->vcpu->vm, far)) {
+        ERROR("no handler for instruction abort (0x%x at 0x%x)", far, vcpu_readpc(cpu()->vcpu));
+    }
+}
+
 static long int standard_service_call(unsigned long _fn_num)
 {
     UNUSED_ARG(_fn_num);
@@ -166,6 +190,7 @@ static void sysreg_handler(unsigned long iss, unsigned long far, unsigned long i
 
 abort_handler_t abort_handlers[64] = {
     [ESR_EC_DALEL] = aborts_data_lower,
+    [ESR_EC_IALEL] = aborts_ins_lower,
     [ESR_EC_SMC32] = smc_handler,
     [ESR_EC_SMC64] = smc_handler,
     [ESR_EC_SYSRG] = sysreg_handler,
@@ -175,8 +200,31 @@ abort_handler_t abort_handlers[64] = {
     [ESR_EC_HVC64] = hvc_handler,
 };
 
+static enum trap_stat aborts_trap_stat(unsigned long ec)
+{
+    switch (ec) {
+        case ESR_EC_DALEL:
+        case ESR_EC_IALEL:
+            return TRAP_STAT_MEM;
+        case ESR_EC_SYSRG:
+        case ESR_EC_RG_32:
+        case ESR_EC_RG_64:
+            return TRAP_STAT_SYSREG;
+        case ESR_EC_HVC32:
+        case ESR_EC_HVC64:
+            return TRAP_STAT_HVC;
+        case ESR_EC_SMC32:
+        case ESR_EC_SMC64:
+            return TRAP_STAT_SMC;
+        default:
+            return TRAP_STAT_OTHER;
+    }
+}
+
 void aborts_sync_handler(void)
 {
+    uint64_t trap_begin = trap_stats_begin();
+    uint64_t exit_begin = trace_begin();
     unsigned long esr = sysreg_esr_el2_read();
     unsigned long far = sysreg_far_el2_read();
     unsigned long hpfar = sysreg_hpfar_el2_read();
@@ -198,4 +246,60 @@ void aborts_sync_handler(void)
     } else {
         ERROR("no handler for abort ec = 0x%x", ec); // unknown guest exception
     }
+
+    trap_stats_end(aborts_trap_stat(ec), trap_begin);
+    trace_span(TRACE_VM_EXIT, exit_begin, (uint32_t)ec);
+}
+
+/**
+ * Highest guest register the fast path might access. Only the caller-saved registers, x0-x18 and
+ * x30, are saved in the vcpu when it is taken.
+ */
+#define ABORTS_FAST_MAX_REG (18)
+
+static bool aborts_fast_reg(unsigned long reg)
+{
+    /* Register 31 stands for xzr, which is never read from the vcpu */
+    return (reg <= ABORTS_FAST_MAX_REG) || (reg == 30) || (reg == 31);
+}
+
+/**
+ * Handles the most frequent synchronous exits, Bao hypercalls and ICC_SGI1R_EL1 writes, when only
+ * the guest's caller-saved registers were saved in the vcpu, the callee-saved ones still being live
+ * in the cpu. Therefore, it only takes exits whose handling neither accesses the callee-saved
+ * registers nor leaves the vcpu for something else, e.g., idling the cpu. Returns false, having
+ * done nothing, for any other exit, which is then handled by the full path.
+ */
+bool aborts_sync_fast_handler(void)
+{
+    unsigned long esr = sysreg_esr_el2_read();
+    unsigned long ec = bit_extract(esr, ESR_EC_OFF, ESR_EC_LEN);
+    unsigned long il = bit_extract(esr, ESR_IL_OFF, ESR_IL_LEN);
+    unsigned long iss = bit_extract(esr, ESR_ISS_OFF, ESR_ISS_LEN);
+
+    if (ec == ESR_EC_HVC64) {
+        unsigned long fid = vcpu_readreg(cpu()->vcpu, 0);
+        if ((fid & ~SMCC_FID_FN_NUM_MSK) != SMCC64_FID_VND_HYP_SRVC) {
+            return false;
+        }
+    } else if (ec == ESR_EC_SYSRG) {
+        regaddr_t reg_addr = (iss & ESR_ISS_SYSREG_ADDR_32) | OP0_MRS_CP15;
+        unsigned long reg = bit_extract(iss, ESR_ISS_SYSREG_REG_OFF, ESR_ISS_SYSREG_REG_LEN);
+        if ((reg_addr != ICC_SGI1R_ADDR) || ((iss & ESR_ISS_SYSREG_DIR) != 0) ||
+            !aborts_fast_reg(reg)) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    uint64_t trap_begin = trap_stats_begin();
+    uint64_t exit_begin = trace_begin();
+
+    abort_handlers[ec](iss, 0, il, ec);
+
+    trap_stats_end(aborts_trap_stat(ec), trap_begin);
+    trace_span(TRACE_VM_EXIT, exit_begin, (uint32_t)ec);
+
+    return true;
 }
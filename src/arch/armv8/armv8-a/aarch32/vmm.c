@@ -21,3 +21,8 @@ void vmm_arch_init_tcr()
 
     sysreg_vtcr_el2_write(vtcr);
 }
+
+void vmm_arch_init_tlb()
+{
+    /* Range invalidations are not available in aarch32 */
+}
@@ -6,6 +6,7 @@
 #include <vmm.h>
 #include <arch/sysregs.h>
 #include <page_table.h>
+#include <arch/tlb.h>
 
 void vmm_arch_init_tcr(void)
 {
@@ -51,3 +52,29 @@ void vmm_arch_init_tcr(void)
 
     sysreg_vtcr_el2_write(vtcr);
 }
+
+bool tlbi_range = false;
+
+void vmm_arch_init_tlb(void)
+{
+    /* Any cpu may have to invalidate a range, so all of them must implement the instructions */
+
+    static bool all_range = true;
+    static spinlock_t lock = SPINLOCK_INITVAL;
+
+    uint64_t tlb =
+        bit64_extract(sysreg_id_aa64isar0_el1_read(), ID_AA64ISAR0_TLB_OFF, ID_AA64ISAR0_TLB_LEN);
+    spin_lock(&lock);
+    if (tlb < ID_AA64ISAR0_TLB_RANGE) {
+        all_range = false;
+    }
+    spin_unlock(&lock);
+
+    cpu_sync_barrier(&cpu_glb_sync);
+
+    if (cpu_is_master()) {
+        tlbi_range = all_range;
+    }
+
+    cpu_sync_barrier(&cpu_glb_sync);
+}
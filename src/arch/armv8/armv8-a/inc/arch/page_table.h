@@ -126,6 +126,9 @@
 
 #define PTE_VM_DEV_FLAGS (PTE_MEMATTR_DEV_GRE | PTE_SH_NS | PTE_S2AP_RW | PTE_AF)
 
+/* Number of last level entries covered by the contiguous hint with the 4KiB granule */
+#define PTE_CONTIG_NUM   (16)
+
 #ifndef __ASSEMBLER__
 
     typedef uint64_t pte_t;
@@ -169,6 +172,35 @@ static inline paddr_t pte_addr(pte_t* pte)
     return (paddr_t)(*pte & PTE_ADDR_MSK);
 }
 
+static inline bool pte_contig(pte_t* pte)
+{
+    return (*pte & PTE_Con) != 0;
+}
+
+static inline void pte_set_contig(pte_t* pte)
+{
+    *pte |= PTE_Con;
+}
+
+/**
+ * Returns the value of a valid entry in a contiguous run once the run is broken up.
+ */
+static inline pte_t pte_contig_clear(pte_t* pte)
+{
+    return *pte & ~(pte_t)PTE_Con;
+}
+
+/* Write permission of stage 2, i.e., vm, entries */
+static inline bool pte_rdonly(pte_t* pte)
+{
+    return (*pte & PTE_S2AP_WO) == 0;
+}
+
+static inline void pte_set_rdonly(pte_t* pte, bool rdonly)
+{
+    *pte = rdonly ? (*pte & ~(pte_t)PTE_S2AP_WO) : (*pte | PTE_S2AP_WO);
+}
+
 #endif /* |__ASSEMBLER__ */
 
 #endif /* __ARCH_PAGE_TABLE_H__ */
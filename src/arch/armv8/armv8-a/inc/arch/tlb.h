@@ -10,59 +10,203 @@
 #include <arch/sysregs.h>
 #include <arch/fences.h>
 
-static inline void tlb_hyp_inv_va(vaddr_t va)
+/**
+ * Invalidations are always broadcast to the inner shareable domain, so the cpus argument, holding
+ * the cpus which might have cached the translations, is ignored. Ranges spanning more than
+ * TLB_INV_RANGE_MAX_PAGES pages are invalidated as a whole address space, which is cheaper than
+ * issuing one invalidation per page.
+ */
+#define TLB_INV_RANGE_MAX_PAGES (64)
+
+#ifdef AARCH64
+
+/**
+ * Set at initialization if all cpus implement FEAT_TLBIRANGE. A range operation covers
+ * (NUM + 1) * 2^(5 * SCALE + 1) pages starting at the base page, so any range below
+ * TLBI_RANGE_MAX_PAGES is covered by at most one operation per scale plus a single page one.
+ */
+extern bool tlbi_range;
+
+#define TLBI_RANGE_TG_4K          (1ULL << 46)
+#define TLBI_RANGE_SCALE_OFF      (44)
+#define TLBI_RANGE_NUM_OFF        (39)
+#define TLBI_RANGE_NUM_MSK        (0x1fUL)
+#define TLBI_RANGE_BADDR_MSK      BIT64_MASK(0, 37)
+#define TLBI_RANGE_PAGES(num, sc) (((num) + 1) << ((5 * (sc)) + 1))
+#define TLBI_RANGE_MAX_PAGES      TLBI_RANGE_PAGES(TLBI_RANGE_NUM_MSK, 3UL)
+
+static inline void tlb_inv_pages_range(bool stage2, vaddr_t va, size_t num_pages)
+{
+    unsigned long scale = 0;
+
+    while (num_pages > 0) {
+        if ((num_pages % 2) != 0) {
+            if (stage2) {
+                arm_tlbi_ipas2e1is(va);
+            } else {
+                arm_tlbi_vae2is(va);
+            }
+            va += PAGE_SIZE;
+            num_pages -= 1;
+            continue;
+        }
+
+        unsigned long num = (num_pages >> ((5 * scale) + 1)) & TLBI_RANGE_NUM_MSK;
+        if (num > 0) {
+            uint64_t range = TLBI_RANGE_TG_4K | ((uint64_t)scale << TLBI_RANGE_SCALE_OFF) |
+                ((uint64_t)(num - 1) << TLBI_RANGE_NUM_OFF) | ((va >> 12) & TLBI_RANGE_BADDR_MSK);
+            if (stage2) {
+                arm_tlbi_ripas2e1is(range);
+            } else {
+                arm_tlbi_rvae2is(range);
+            }
+            va += TLBI_RANGE_PAGES(num - 1, scale) * PAGE_SIZE;
+            num_pages -= TLBI_RANGE_PAGES(num - 1, scale);
+        }
+        scale++;
+    }
+}
+
+#endif
+
+static inline size_t tlb_inv_range_max_pages(void)
+{
+#ifdef AARCH64
+    if (tlbi_range) {
+        return TLBI_RANGE_MAX_PAGES - 1;
+    }
+#endif
+    return TLB_INV_RANGE_MAX_PAGES;
+}
+
+/**
+ * Invalidates num_pages pages from va, either stage 2 entries of the current vmid or hypervisor
+ * ones. The caller must issue the barriers.
+ */
+static inline void tlb_inv_pages(bool stage2, vaddr_t va, size_t num_pages)
 {
+#ifdef AARCH64
+    if (tlbi_range) {
+        tlb_inv_pages_range(stage2, va, num_pages);
+        return;
+    }
+#endif
+
+    for (size_t i = 0; i < num_pages; i++) {
+        if (stage2) {
+            arm_tlbi_ipas2e1is(va + (i * PAGE_SIZE));
+        } else {
+            arm_tlbi_vae2is(va + (i * PAGE_SIZE));
+        }
+    }
+}
+
+static inline void tlb_hyp_inv_va(cpumap_t cpus, vaddr_t va)
+{
+    UNUSED_ARG(cpus);
+
     DSB(ish);
     arm_tlbi_vae2is(va);
     DSB(ish);
     ISB();
 }
 
-static inline void tlb_hyp_inv_all(void)
+static inline void tlb_hyp_inv_all(cpumap_t cpus)
 {
+    UNUSED_ARG(cpus);
+
     DSB(ish);
     arm_tlbi_alle2is();
     DSB(ish);
     ISB();
 }
 
-static inline void tlb_vm_inv_va(asid_t vmid, vaddr_t va)
+static inline void tlb_hyp_inv_range(cpumap_t cpus, vaddr_t va, size_t size)
 {
-    uint64_t vttbr = 0;
-    vttbr = sysreg_vttbr_el2_read();
-    bool switch_vmid = bit64_extract(vttbr, VTTBR_VMID_OFF, VTTBR_VMID_LEN) != vmid;
+    size_t num_pages = size / PAGE_SIZE;
+    if (num_pages > tlb_inv_range_max_pages()) {
+        tlb_hyp_inv_all(cpus);
+        return;
+    }
 
-    if (switch_vmid) {
-        sysreg_vttbr_el2_write(((uint64_t)vmid << VTTBR_VMID_OFF) & VTTBR_VMID_MSK);
-        DSB(ish);
-        ISB();
+    DSB(ish);
+    tlb_inv_pages(false, va, num_pages);
+    DSB(ish);
+    ISB();
+}
+
+/**
+ * Stage 2 invalidations apply to the vmid in VTTBR_EL2. If it is not the target one, it is switched
+ * once for the whole operation and restored at the end. Returns whether it was switched, saving
+ * the value to restore in vttbr.
+ */
+static inline bool tlb_vm_switch(asid_t vmid, uint64_t* vttbr)
+{
+    *vttbr = sysreg_vttbr_el2_read();
+    if (bit64_extract(*vttbr, VTTBR_VMID_OFF, VTTBR_VMID_LEN) == vmid) {
+        return false;
     }
 
-    arm_tlbi_ipas2e1is(va);
+    sysreg_vttbr_el2_write(((uint64_t)vmid << VTTBR_VMID_OFF) & VTTBR_VMID_MSK);
+    ISB();
+    return true;
+}
 
-    if (switch_vmid) {
-        DSB(ish);
-        sysreg_vttbr_el2_write(((uint64_t)vmid << VTTBR_VMID_OFF) & VTTBR_VMID_MSK);
+static inline void tlb_vm_restore(bool switched, uint64_t vttbr)
+{
+    if (switched) {
+        sysreg_vttbr_el2_write(vttbr);
+        ISB();
     }
 }
 
-static inline void tlb_vm_inv_all(asid_t vmid)
+/**
+ * Invalidating by ipa only reaches entries holding stage 2 translations alone. Entries combining
+ * both stages of translation can only be invalidated for the whole vmid, which is done once, after
+ * all the ipa invalidations complete.
+ */
+static inline void tlb_vm_inv_ipas(asid_t vmid, vaddr_t va, size_t num_pages)
 {
     uint64_t vttbr = 0;
-    vttbr = sysreg_vttbr_el2_read();
-    bool switch_vmid = bit64_extract(vttbr, VTTBR_VMID_OFF, VTTBR_VMID_LEN) != vmid;
+    bool switched = tlb_vm_switch(vmid, &vttbr);
 
-    if (switch_vmid) {
-        sysreg_vttbr_el2_write(((uint64_t)vmid << VTTBR_VMID_OFF) & VTTBR_VMID_MSK);
-        DSB(ish);
-        ISB();
-    }
+    DSB(ish);
+    tlb_inv_pages(true, va, num_pages);
+    DSB(ish);
+    arm_tlbi_vmalle1is();
+    DSB(ish);
+
+    tlb_vm_restore(switched, vttbr);
+}
+
+static inline void tlb_vm_inv_va(cpumap_t cpus, asid_t vmid, vaddr_t va)
+{
+    UNUSED_ARG(cpus);
+
+    tlb_vm_inv_ipas(vmid, va, 1);
+}
+
+static inline void tlb_vm_inv_all(cpumap_t cpus, asid_t vmid)
+{
+    UNUSED_ARG(cpus);
 
+    uint64_t vttbr = 0;
+    bool switched = tlb_vm_switch(vmid, &vttbr);
+
+    DSB(ish);
     arm_tlbi_vmalls12e1is();
+    DSB(ish);
 
-    if (switch_vmid) {
-        DSB(ish);
-        sysreg_vttbr_el2_write(vttbr);
+    tlb_vm_restore(switched, vttbr);
+}
+
+static inline void tlb_vm_inv_range(cpumap_t cpus, asid_t vmid, vaddr_t va, size_t size)
+{
+    size_t num_pages = size / PAGE_SIZE;
+    if (num_pages > tlb_inv_range_max_pages()) {
+        tlb_vm_inv_all(cpus, vmid);
+    } else {
+        tlb_vm_inv_ipas(vmid, va, num_pages);
     }
 }
 
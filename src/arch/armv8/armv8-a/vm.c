@@ -18,5 +18,5 @@ void vcpu_arch_profile_init(struct vcpu* vcpu, struct vm* vm)
         (root_pt_pa & ~VTTBR_VMID_MSK));
 
     ISB(); // make sure vmid is commited befor tlbi
-    tlb_vm_inv_all(vm->id);
+    tlb_vm_inv_all(vm->cpus, vm->id);
 }
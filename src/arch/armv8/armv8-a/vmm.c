@@ -8,4 +8,5 @@
 void vmm_arch_profile_init()
 {
     vmm_arch_init_tcr();
+    vmm_arch_init_tlb();
 }
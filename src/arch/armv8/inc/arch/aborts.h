@@ -9,6 +9,7 @@
 #include <bao.h>
 
 void aborts_sync_handler(void);
+bool aborts_sync_fast_handler(void);
 void internal_abort_handler(unsigned long gprs[]);
 
 #endif /* __ABORTS_H__ */
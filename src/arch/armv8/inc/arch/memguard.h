@@ -0,0 +1,30 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __ARCH_MEMGUARD_H__
+#define __ARCH_MEMGUARD_H__
+
+#include <bao.h>
+
+/* Interrupt ids recommended by the architecture for the PMU and the EL2 physical timer */
+#define MEMGUARD_ARCH_PMU_IRQ   (23)
+#define MEMGUARD_ARCH_TIMER_IRQ (26)
+
+/* Event charged against the budget, L2D_CACHE_REFILL unless overriden at build time */
+#ifndef MEMGUARD_ARCH_EVENT
+#define MEMGUARD_ARCH_EVENT (0x17)
+#endif
+
+bool memguard_arch_init(void);
+void memguard_arch_pmu_set(uint32_t budget);
+void memguard_arch_pmu_ack(void);
+void memguard_arch_timer_set(uint64_t deadline);
+
+static inline void memguard_arch_wait(void)
+{
+    __asm__ volatile("wfi" ::: "memory");
+}
+
+#endif /* __ARCH_MEMGUARD_H__ */
@@ -17,6 +17,11 @@
 
 #define PAR_32BIT                 (0)
 
+/* ID_AA64ISAR0_EL1, AArch64 Instruction Set Attribute Register 0 */
+#define ID_AA64ISAR0_TLB_OFF      56
+#define ID_AA64ISAR0_TLB_LEN      4
+#define ID_AA64ISAR0_TLB_RANGE    (0x2)
+
 #define SPSel_SP                  (1 << 0)
 
 /* PSTATE */
@@ -330,6 +335,23 @@
 #define HCR_APK_BIT                (1ULL << 40)
 #define HCR_API_BIT                (1ULL << 41)
 
+/* MDCR_EL2 - Hypervisor Debug Configuration Register */
+
+#define MDCR_HPMN_OFF              (0)
+#define MDCR_HPMN_LEN              (5)
+#define MDCR_HPMN_MSK              BIT32_MASK(MDCR_HPMN_OFF, MDCR_HPMN_LEN)
+#define MDCR_HPME_BIT              (1UL << 7)
+
+/* PMCR_EL0 - Performance Monitors Control Register */
+
+#define PMCR_N_OFF                 (11)
+#define PMCR_N_LEN                 (5)
+
+/* CNTHP_CTL_EL2 - Hypervisor Physical Timer Control Register */
+
+#define CNTHP_CTL_ENABLE_BIT       (1UL << 0)
+#define CNTHP_CTL_IMASK_BIT        (1UL << 1)
+
 /* ESR_ELx, Exception Syndrome Register (ELx) */
 
 #define ESR_ISS_OFF                (0)
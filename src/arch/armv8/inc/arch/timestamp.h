@@ -0,0 +1,25 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __ARCH_TIMESTAMP_H__
+#define __ARCH_TIMESTAMP_H__
+
+#include <bao.h>
+#include <arch/sysregs.h>
+#include <arch/fences.h>
+
+/* Generic timer physical count. The isb keeps it from being read ahead of preceding code. */
+static inline uint64_t timestamp_get(void)
+{
+    ISB();
+    return sysreg_cntpct_el0_read();
+}
+
+static inline uint64_t timestamp_freq(void)
+{
+    return sysreg_cntfrq_el0_read();
+}
+
+#endif /* __ARCH_TIMESTAMP_H__ */
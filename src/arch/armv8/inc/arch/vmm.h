@@ -8,5 +8,6 @@
 
 void vmm_arch_profile_init(void);
 void vmm_arch_init_tcr(void);
+void vmm_arch_init_tlb(void);
 
 #endif /* ARCH_VMM_H */
@@ -0,0 +1,79 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <arch/memguard.h>
+#include <arch/sysregs.h>
+#include <arch/fences.h>
+#include <bit.h>
+
+/**
+ * The budget is counted by the last PMU counter, reserved for the hypervisor through MDCR_EL2.HPMN.
+ * Thus, the guest sees one counter less. Its index is selected through PMSELR_EL0, which the guest
+ * also uses, so it is restored after each access.
+ */
+static unsigned long memguard_arch_counter(void)
+{
+    return bit_extract(sysreg_pmcr_el0_read(), PMCR_N_OFF, PMCR_N_LEN) - 1;
+}
+
+static void memguard_arch_counter_write(uint32_t val)
+{
+    unsigned long pmselr = sysreg_pmselr_el0_read();
+    sysreg_pmselr_el0_write(memguard_arch_counter());
+    ISB();
+    sysreg_pmxevcntr_el0_write(val);
+    sysreg_pmselr_el0_write(pmselr);
+}
+
+bool memguard_arch_init(void)
+{
+    unsigned long counters = bit_extract(sysreg_pmcr_el0_read(), PMCR_N_OFF, PMCR_N_LEN);
+    if (counters < 2) {
+        return false;
+    }
+
+    unsigned long counter = counters - 1;
+    unsigned long mdcr = sysreg_mdcr_el2_read() & ~MDCR_HPMN_MSK;
+    sysreg_mdcr_el2_write(mdcr | (counter << MDCR_HPMN_OFF) | MDCR_HPME_BIT);
+
+    unsigned long pmselr = sysreg_pmselr_el0_read();
+    sysreg_pmselr_el0_write(counter);
+    ISB();
+    /* Only events at EL0 and EL1 are counted, i.e., the guest's */
+    sysreg_pmxevtyper_el0_write(MEMGUARD_ARCH_EVENT);
+    sysreg_pmselr_el0_write(pmselr);
+
+    sysreg_pmcntenset_el0_write(1UL << counter);
+    ISB();
+
+    return true;
+}
+
+void memguard_arch_pmu_set(uint32_t budget)
+{
+    unsigned long counter_bit = 1UL << memguard_arch_counter();
+
+    /* The counter overflows once it counts budget events */
+    memguard_arch_counter_write(UINT32_MAX - budget + 1);
+    sysreg_pmovsclr_el0_write(counter_bit);
+    sysreg_pmintenset_el1_write(counter_bit);
+    ISB();
+}
+
+void memguard_arch_pmu_ack(void)
+{
+    unsigned long counter_bit = 1UL << memguard_arch_counter();
+
+    sysreg_pmintenclr_el1_write(counter_bit);
+    sysreg_pmovsclr_el0_write(counter_bit);
+    ISB();
+}
+
+void memguard_arch_timer_set(uint64_t deadline)
+{
+    sysreg_cnthp_cval_el2_write(deadline);
+    sysreg_cnthp_ctl_el2_write(CNTHP_CTL_ENABLE_BIT);
+    ISB();
+}
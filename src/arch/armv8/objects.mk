@@ -11,6 +11,7 @@ cpu-objs-y+=gic.o
 cpu-objs-y+=vgic.o
 cpu-objs-y+=vmm.o
 cpu-objs-y+=psci.o
+cpu-objs-$(MEMGUARD)+=memguard.o
 
 ifeq ($(GIC_VERSION), GICV2)
 	cpu-objs-y+=vgicv2.o
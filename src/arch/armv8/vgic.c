@@ -21,6 +21,7 @@
 #include <interrupts.h>
 #include <vm.h>
 #include <platform.h>
+#include <trace.h>
 
 enum VGIC_EVENTS { VGIC_UPDATE_ENABLE, VGIC_ROUTE, VGIC_INJECT, VGIC_SET_REG };
 extern volatile const size_t VGIC_IPI_ID;
@@ -137,11 +138,7 @@ void vgic_send_sgi_msg(struct vcpu* vcpu, cpumap_t pcpu_mask, irqid_t int_id)
         VGIC_MSG_DATA(cpu()->vcpu->vm->id, 0, int_id, 0, cpu()->vcpu->id),
     };
 
-    for (size_t i = 0; i < platform.cpu_num; i++) {
-        if (pcpu_mask & (1ULL << i)) {
-            cpu_send_msg(i, &msg);
-        }
-    }
+    cpu_send_msg_multicast(pcpu_mask, &msg);
 }
 
 static void vgic_route(struct vcpu* vcpu, struct vgic_int* interrupt)
@@ -162,11 +159,7 @@ static void vgic_route(struct vcpu* vcpu, struct vgic_int* interrupt)
         };
         vgic_yield_ownership(vcpu, interrupt);
         cpumap_t trgtlist = vgic_int_ptarget_mask(vcpu, interrupt) & ~(1UL << vcpu->phys_id);
-        for (size_t i = 0; i < platform.cpu_num; i++) {
-            if (trgtlist & (1ULL << i)) {
-                cpu_send_msg(i, &msg);
-            }
-        }
+        cpu_send_msg_multicast(trgtlist, &msg);
     }
 }
 
@@ -304,6 +297,7 @@ static void vgic_spill_lr(struct vcpu* vcpu, size_t lr_ind)
 
     if (spilled_int != NULL) {
         spin_lock(&spilled_int->lock);
+        trace_event(TRACE_LR_SPILL, (uint32_t)spilled_int->id, lr_ind);
         vgic_remove_lr(vcpu, spilled_int);
         vgic_add_spilled(vcpu, spilled_int);
         vgic_yield_ownership(vcpu, spilled_int);
@@ -1099,6 +1093,7 @@ static void vgic_refill_lrs(struct vcpu* vcpu, bool npie)
             if (got_ownership) {
                 list_rm(list, &irq->node);
                 vgic_write_lr(vcpu, irq, (size_t)lr_ind);
+                trace_event(TRACE_LR_REFILL, (uint32_t)irq->id, (uint64_t)lr_ind);
             }
             spin_unlock(&irq->lock);
             if (!got_ownership) {
@@ -1167,6 +1162,7 @@ void gic_maintenance_handler(irqid_t irq_id)
 {
     UNUSED_ARG(irq_id);
 
+    uint64_t trap_begin = trap_stats_begin();
     uint32_t misr = gich_get_misr();
 
     if (misr & GICH_MISR_EOI) {
@@ -1186,6 +1182,8 @@ void gic_maintenance_handler(irqid_t irq_id)
             hcr_el2 = gich_get_hcr();
         }
     }
+
+    trap_stats_end(TRAP_STAT_MAINT, trap_begin);
 }
 
 size_t vgic_get_itln(const struct vgic_dscrp* vgic_dscrp)
@@ -8,11 +8,14 @@
 #include <fences.h>
 #include <string.h>
 #include <config.h>
+#include <boot_prof.h>
 
 void vm_arch_init(struct vm* vm, const struct vm_config* vm_config)
 {
     if (vm->master == cpu()->id) {
+        uint64_t vgic_begin = boot_prof_begin();
         vgic_init(vm, &vm_config->platform.arch.gic);
+        boot_prof_end(BOOT_PROF_VIRQC_INIT, vgic_begin);
     }
     cpu_sync_and_clear_msgs(&vm->sync);
 }
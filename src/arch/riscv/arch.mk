@@ -44,7 +44,12 @@ arch-cflags = -mcmodel=medany -march=$(riscv_march) -mstrict-align \
 arch-asflags =
 arch-ldflags = -m $(ld_emulation)
 
+ifeq ($(MEMGUARD),y)
+$(error MEMGUARD is not supported on RISC-V)
+endif
+
 arch_mem_prot:=mmu
+arch_string:=y
 PAGE_SIZE:=0x1000
 
 clang_arch_target:=riscv64
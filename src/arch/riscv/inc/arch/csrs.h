@@ -305,11 +305,16 @@ CSRS_GEN_ACCESSORS_NAMED(stopei, CSR_STOPEI)
 CSRS_GEN_ACCESSORS_NAMED(stopi, CSR_STOPI)
 
 #if (RV64)
+CSRS_GEN_ACCESSORS(time)
 CSRS_GEN_ACCESSORS_NAMED(stimecmp, CSR_STIMECMP)
 CSRS_GEN_ACCESSORS_NAMED(vstimecmp, CSR_VSTIMECMP)
 CSRS_GEN_ACCESSORS_NAMED(henvcfg, CSR_HENVCFG)
 CSRS_GEN_ACCESSORS_NAMED(htimedelta, CSR_HTIMEDELTA)
 #else
+CSRS_GEN_ACCESSORS_NAMED(timel, time)
+CSRS_GEN_ACCESSORS_NAMED(timeh, timeh)
+CSRS_GEN_ACCESSORS_MERGED(time, timel, timeh)
+
 CSRS_GEN_ACCESSORS_NAMED(henvcfgl, CSR_HENVCFG)
 CSRS_GEN_ACCESSORS_NAMED(henvcfgh, CSR_HENVCFGH)
 CSRS_GEN_ACCESSORS_MERGED(henvcfg, henvcfgl, henvcfgh)
@@ -14,4 +14,25 @@ static inline uint64_t hlvxhu(uintptr_t addr)
     return value;
 }
 
+static inline void sfence_vma(uintptr_t va)
+{
+    __asm__ volatile("sfence.vma %0, zero\n\t" ::"r"(va) : "memory");
+}
+
+static inline void sfence_vma_all(void)
+{
+    __asm__ volatile("sfence.vma zero, zero\n\t" ::: "memory");
+}
+
+static inline void hfence_gvma_vmid(uintptr_t gpa, unsigned long vmid)
+{
+    __asm__ volatile(".insn r 0x73, 0x0, 0x31, x0, %0, %1\n\t" ::"r"(gpa >> 2), "r"(vmid)
+                     : "memory");
+}
+
+static inline void hfence_gvma_vmid_all(unsigned long vmid)
+{
+    __asm__ volatile(".insn r 0x73, 0x0, 0x31, x0, x0, %0\n\t" ::"r"(vmid) : "memory");
+}
+
 #endif /* ARCH_INSTRUCTIONS_H */
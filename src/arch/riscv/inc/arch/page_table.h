@@ -69,6 +69,16 @@
 #define PTE_VM_FLAGS              (PTE_ACCESS | PTE_DIRTY | PTE_USER)
 #define PTE_VM_DEV_FLAGS          PTE_VM_FLAGS
 
+#if (RV64)
+/* Svnapot 64KiB pages, the only size currently defined */
+#define PTE_NAPOT                 (1ULL << 63)
+#define PTE_NAPOT_PPN_MSK         PTE_MASK(10, 4)
+#define PTE_NAPOT_PPN_64K         (0x8ULL << 10)
+#define PTE_CONTIG_NUM            (16)
+#else
+#define PTE_CONTIG_NUM            (0)
+#endif
+
 #ifndef __ASSEMBLER__
 
 #if (RV32)
@@ -94,14 +104,54 @@ static inline void pte_set(pte_t* pte, paddr_t addr, pte_type_t type, pte_flags_
 
 static inline paddr_t pte_addr(pte_t* pte)
 {
+#if (RV64)
+    if (*pte & PTE_NAPOT) {
+        /**
+         * The low ppn bits of a napot entry encode its size, so the entry's page is found from its
+         * position in the run. Thus, this must be given the entry in the page table, not a copy.
+         */
+        size_t index = ((uintptr_t)pte / sizeof(pte_t)) % PTE_CONTIG_NUM;
+        return (((*pte & ~PTE_NAPOT_PPN_MSK) << 2) & PTE_ADDR_MSK) + (index * PAGE_SIZE);
+    }
+#endif
     return (*pte << 2) & PTE_ADDR_MSK;
 }
 
+#if (RV64)
+static inline bool pte_contig(pte_t* pte)
+{
+    return (*pte & PTE_NAPOT) != 0;
+}
+
+static inline void pte_set_contig(pte_t* pte)
+{
+    *pte = (*pte & ~PTE_NAPOT_PPN_MSK) | PTE_NAPOT_PPN_64K | PTE_NAPOT;
+}
+
+/**
+ * Returns the value of a valid entry in a contiguous run once the run is broken up.
+ */
+static inline pte_t pte_contig_clear(pte_t* pte)
+{
+    return (*pte & ~(PTE_NAPOT | PTE_NAPOT_PPN_MSK)) | ((pte_addr(pte) >> 2) & PTE_NAPOT_PPN_MSK);
+}
+#endif
+
 static inline bool pte_valid(pte_t* pte)
 {
     return (*pte & PTE_VALID);
 }
 
+static inline bool pte_rdonly(pte_t* pte)
+{
+    return (*pte & PTE_WRITE) == 0;
+}
+
+static inline void pte_set_rdonly(pte_t* pte, bool rdonly)
+{
+    *pte = rdonly ? (*pte & ~(pte_t)PTE_WRITE) : (*pte | PTE_WRITE);
+}
+
 static inline void pte_set_rsw(pte_t* pte, pte_flags_t flag)
 {
     *pte = (*pte & ~PTE_RSW_MSK) | (flag & PTE_RSW_MSK);
@@ -35,6 +35,7 @@ struct sbi_hsm {
 
 void sbi_init(void);
 size_t sbi_vs_handler(void);
+bool sbi_vs_fast_handler(void);
 
 void sbi_console_putchar(int ch);
 
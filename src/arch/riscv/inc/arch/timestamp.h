@@ -0,0 +1,23 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __ARCH_TIMESTAMP_H__
+#define __ARCH_TIMESTAMP_H__
+
+#include <bao.h>
+#include <arch/csrs.h>
+
+static inline uint64_t timestamp_get(void)
+{
+    return csrs_time_read();
+}
+
+/* The timebase frequency is not part of the platform description, so it is reported as unknown */
+static inline uint64_t timestamp_freq(void)
+{
+    return 0;
+}
+
+#endif /* __ARCH_TIMESTAMP_H__ */
@@ -7,35 +7,83 @@
 #define __ARCH_TLB_H__
 
 #include <bao.h>
-#include <platform.h>
+#include <cpu.h>
 #include <arch/sbi.h>
+#include <arch/instructions.h>
 
 /**
- * TODO: we are assuming platform.cpu_num is power of two. Make this not true.
+ * Invalidations only reach the harts in cpus, which must hold every hart that might have cached
+ * the translations. If that is the current hart alone, the fences are executed locally instead of
+ * going through the SBI. Local ranges spanning more than TLB_LOCAL_RANGE_MAX_PAGES pages are
+ * invalidated as a whole.
  */
+#define TLB_LOCAL_RANGE_MAX_PAGES (64)
 
-static inline void tlb_hyp_inv_va(vaddr_t va)
+static inline bool tlb_local(cpumap_t cpus)
 {
-    sbi_remote_sfence_vma((1U << platform.cpu_num) - 1, 0, (unsigned long)va, PAGE_SIZE);
+    return cpus == (1UL << cpu()->id);
 }
 
-static inline void tlb_hyp_inv_all(void)
+static inline void tlb_hyp_inv_va(cpumap_t cpus, vaddr_t va)
 {
-    sbi_remote_sfence_vma((1U << platform.cpu_num) - 1, 0, 0, 0);
+    if (tlb_local(cpus)) {
+        sfence_vma(va);
+    } else {
+        sbi_remote_sfence_vma(cpus, 0, (unsigned long)va, PAGE_SIZE);
+    }
 }
 
-/**
- * TODO: change hart_mask to only take into account the vm physical cpus.
- */
+static inline void tlb_hyp_inv_range(cpumap_t cpus, vaddr_t va, size_t size)
+{
+    if (!tlb_local(cpus)) {
+        sbi_remote_sfence_vma(cpus, 0, (unsigned long)va, size);
+    } else if ((size / PAGE_SIZE) > TLB_LOCAL_RANGE_MAX_PAGES) {
+        sfence_vma_all();
+    } else {
+        for (vaddr_t addr = va; addr < (va + size); addr += PAGE_SIZE) {
+            sfence_vma(addr);
+        }
+    }
+}
+
+static inline void tlb_hyp_inv_all(cpumap_t cpus)
+{
+    if (tlb_local(cpus)) {
+        sfence_vma_all();
+    } else {
+        sbi_remote_sfence_vma(cpus, 0, 0, 0);
+    }
+}
+
+static inline void tlb_vm_inv_va(cpumap_t cpus, asid_t vmid, vaddr_t va)
+{
+    if (tlb_local(cpus)) {
+        hfence_gvma_vmid(va, vmid);
+    } else {
+        sbi_remote_hfence_gvma_vmid(cpus, 0, (unsigned long)va, PAGE_SIZE, vmid);
+    }
+}
 
-static inline void tlb_vm_inv_va(asid_t vmid, vaddr_t va)
+static inline void tlb_vm_inv_range(cpumap_t cpus, asid_t vmid, vaddr_t va, size_t size)
 {
-    sbi_remote_hfence_gvma_vmid((1U << platform.cpu_num) - 1, 0, (unsigned long)va, PAGE_SIZE, vmid);
+    if (!tlb_local(cpus)) {
+        sbi_remote_hfence_gvma_vmid(cpus, 0, (unsigned long)va, size, vmid);
+    } else if ((size / PAGE_SIZE) > TLB_LOCAL_RANGE_MAX_PAGES) {
+        hfence_gvma_vmid_all(vmid);
+    } else {
+        for (vaddr_t addr = va; addr < (va + size); addr += PAGE_SIZE) {
+            hfence_gvma_vmid(addr, vmid);
+        }
+    }
 }
 
-static inline void tlb_vm_inv_all(asid_t vmid)
+static inline void tlb_vm_inv_all(cpumap_t cpus, asid_t vmid)
 {
-    sbi_remote_hfence_gvma_vmid((1U << platform.cpu_num) - 1, 0, 0, 0, vmid);
+    if (tlb_local(cpus)) {
+        hfence_gvma_vmid_all(vmid);
+    } else {
+        sbi_remote_hfence_gvma_vmid(cpus, 0, 0, 0, vmid);
+    }
 }
 
 #endif /* __ARCH_TLB_H__ */
@@ -10,6 +10,8 @@
 #include <bit.h>
 #include <fences.h>
 #include <hypercall.h>
+#include <trap_stats.h>
+#include <trace.h>
 
 #define SBI_EXTID_BASE                  (0x10)
 #define SBI_GET_SBI_SPEC_VERSION_FID    (0)
@@ -244,17 +246,20 @@ static struct sbiret sbi_ipi_handler(unsigned long fid)
         .handler = (uint32_t)SBI_MSG_ID,
         .event = SEND_IPI,
     };
+    cpumap_t phart_mask = 0;
 
     for (size_t i = 0; i < sizeof(hart_mask) * 8; i++) {
         if (bit_get(hart_mask, i)) {
             vcpuid_t vhart_id = hart_mask_base + i;
             cpuid_t phart_id = vm_translate_to_pcpuid(cpu()->vcpu->vm, vhart_id);
             if (phart_id != INVALID_CPUID) {
-                cpu_send_msg(phart_id, &msg);
+                phart_mask |= (1UL << phart_id);
             }
         }
     }
 
+    cpu_send_msg_multicast(phart_mask, &msg);
+
     return (struct sbiret){ SBI_SUCCESS, 0 };
 }
 
@@ -448,6 +453,30 @@ size_t sbi_vs_handler()
     return 4;
 }
 
+/**
+ * Handles the most frequent ecalls, timer programming and IPIs, when only the guest's caller-saved
+ * registers were saved in the vcpu, the callee-saved ones still being live in the cpu. Both only
+ * access argument registers and always return to the same vcpu. Returns false, having done
+ * nothing, for any other ecall, which is then handled by the full path.
+ */
+bool sbi_vs_fast_handler(void)
+{
+    unsigned long extid = vcpu_readreg(cpu()->vcpu, REG_A7);
+    if ((extid != SBI_EXTID_TIME) && (extid != SBI_EXTID_IPI)) {
+        return false;
+    }
+
+    uint64_t trap_begin = trap_stats_begin();
+    uint64_t exit_begin = trace_begin();
+
+    cpu()->vcpu->regs.sepc += sbi_vs_handler();
+
+    trap_stats_end(TRAP_STAT_HVC, trap_begin);
+    trace_span(TRACE_VM_EXIT, exit_begin, (uint32_t)SCAUSE_CODE_ECV);
+
+    return true;
+}
+
 void sbi_init()
 {
     struct sbiret ret;
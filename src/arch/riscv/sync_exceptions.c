@@ -6,6 +6,8 @@
 #include <bao.h>
 #include <cpu.h>
 #include <vm.h>
+#include <tlb.h>
+#include <trace.h>
 #include <arch/encoding.h>
 #include <arch/csrs.h>
 #include <arch/instructions.h>
@@ -78,10 +80,39 @@ static inline bool is_pseudo_ins(uint32_t ins)
     return ins == TINST_PSEUDO_STORE || ins == TINST_PSEUDO_LOAD;
 }
 
+static bool guest_mem_fault(vaddr_t addr)
+{
+    if (vm_mem_fault(cpu()->vcpu->vm, addr)) {
+        /**
+         * Invalid entries might have been cached, so make sure the retried access sees the newly
+         * populated batch.
+         */
+        tlb_inv_va(&cpu()->vcpu->vm->as, addr);
+        return true;
+    }
+    return false;
+}
+
+static size_t guest_ins_page_fault_handler(void)
+{
+    vaddr_t addr = csrs_htval_read() << 2;
+
+    if (!guest_mem_fault(addr)) {
+        ERROR("no handler for instruction guest page fault (0x%x at 0x%x)", addr,
+            csrs_sepc_read());
+    }
+
+    return 0;
+}
+
 static size_t guest_page_fault_handler(void)
 {
     vaddr_t addr = csrs_htval_read() << 2;
 
+    if (guest_mem_fault(addr)) {
+        return 0;
+    }
+
     emul_handler_t handler = vm_emul_get_mem(cpu()->vcpu->vm, addr);
     if (handler != NULL) {
         unsigned long ins = csrs_htinst_read();
@@ -128,6 +159,7 @@ static size_t guest_page_fault_handler(void)
 
 sync_handler_t sync_handler_table[] = {
     [SCAUSE_CODE_ECV] = sbi_vs_handler,
+    [SCAUSE_CODE_IGPF] = guest_ins_page_fault_handler,
     [SCAUSE_CODE_LGPF] = guest_page_fault_handler,
     [SCAUSE_CODE_SGPF] = guest_page_fault_handler,
 };
@@ -135,8 +167,24 @@ sync_handler_t sync_handler_table[] = {
 static const size_t sync_handler_table_size = sizeof(sync_handler_table) / sizeof(sync_handler_t);
 
 void sync_exception_handler(void);
+static enum trap_stat sync_exception_trap_stat(unsigned long scause)
+{
+    switch (scause) {
+        case SCAUSE_CODE_IGPF:
+        case SCAUSE_CODE_LGPF:
+        case SCAUSE_CODE_SGPF:
+            return TRAP_STAT_MEM;
+        case SCAUSE_CODE_ECV:
+            return TRAP_STAT_HVC;
+        default:
+            return TRAP_STAT_OTHER;
+    }
+}
+
 void sync_exception_handler(void)
 {
+    uint64_t trap_begin = trap_stats_begin();
+    uint64_t exit_begin = trace_begin();
     size_t pc_step = 0;
     unsigned long _scause = csrs_scause_read();
 
@@ -153,4 +201,7 @@ void sync_exception_handler(void)
     }
 
     cpu()->vcpu->regs.sepc += pc_step;
+
+    trap_stats_end(sync_exception_trap_stat(_scause), trap_begin);
+    trace_span(TRACE_VM_EXIT, exit_begin, (uint32_t)_scause);
 }
@@ -10,6 +10,7 @@
 #include <arch/instructions.h>
 #include <string.h>
 #include <config.h>
+#include <boot_prof.h>
 
 void vm_arch_init(struct vm* vm, const struct vm_config* vm_config)
 {
@@ -21,7 +22,9 @@ void vm_arch_init(struct vm* vm, const struct vm_config* vm_config)
 
     csrs_hgatp_write(hgatp);
 
+    uint64_t virqc_begin = boot_prof_begin();
     virqc_init(vm, &vm_config->platform.arch.irqc);
+    boot_prof_end(BOOT_PROF_VIRQC_INIT, virqc_begin);
 }
 
 void vcpu_arch_init(struct vcpu* vcpu, struct vm* vm)
@@ -0,0 +1,117 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <boot_prof.h>
+#include <cpu.h>
+#include <vm.h>
+#include <fences.h>
+#include <platform.h>
+#include <arch/timestamp.h>
+
+struct boot_prof_cpu {
+    uint64_t entry;
+    uint64_t vcpu_run;
+    uint64_t first[BOOT_PROF_PHASE_NUM];
+    uint64_t ticks[BOOT_PROF_PHASE_NUM];
+    unsigned long count[BOOT_PROF_PHASE_NUM];
+    bool active;
+    volatile bool done;
+};
+
+static struct boot_prof_cpu boot_prof[PLAT_CPU_NUM];
+
+static const char* const boot_prof_phase_name[BOOT_PROF_PHASE_NUM] = {
+    [BOOT_PROF_MEM_INIT] = "mem_init",
+    [BOOT_PROF_VMM_ASSIGN_VCPU] = "vmm_assign_vcpu",
+    [BOOT_PROF_VM_INIT_MEM_REGIONS] = "vm_init_mem_regions",
+    [BOOT_PROF_VM_INSTALL_IMAGE] = "vm_install_image",
+    [BOOT_PROF_MEM_MAP_RECLR] = "mem_map_reclr",
+    [BOOT_PROF_VIRQC_INIT] = "virqc_init",
+    [BOOT_PROF_SYNC_WAIT] = "sync_wait",
+};
+
+uint64_t boot_prof_begin(void)
+{
+    return timestamp_get();
+}
+
+void boot_prof_end(enum boot_prof_phase phase, uint64_t begin)
+{
+    uint64_t now = timestamp_get();
+    struct boot_prof_cpu* prof = &boot_prof[cpu()->id];
+
+    /**
+     * During mem_init the image might still be copied into its colored region, and after the
+     * report the data is already out, so only record in between.
+     */
+    if (!prof->active) {
+        return;
+    }
+
+    if (prof->count[phase] == 0) {
+        prof->first[phase] = begin;
+    }
+    prof->ticks[phase] += now - begin;
+    prof->count[phase]++;
+}
+
+void boot_prof_start(uint64_t entry)
+{
+    struct boot_prof_cpu* prof = &boot_prof[cpu()->id];
+
+    prof->entry = entry;
+    prof->active = true;
+}
+
+static void boot_prof_print_row(vmid_t vm_id, cpuid_t cpu_id, const char* phase, uint64_t start,
+    uint64_t ticks, unsigned long count)
+{
+    long offset = (long)(start - boot_prof[CPU_MASTER].entry);
+    console_printk("BOOTPROF\t%lu\t%lu\t%s\t%ld\t%lu\t%lu\n", (unsigned long)vm_id,
+        (unsigned long)cpu_id, phase, offset, (unsigned long)ticks, count);
+}
+
+void boot_prof_report(struct vm* vm)
+{
+    struct boot_prof_cpu* prof = &boot_prof[cpu()->id];
+
+    prof->vcpu_run = timestamp_get();
+    prof->active = false;
+    fence_ord_write();
+    prof->done = true;
+
+    if (vm->master != cpu()->id) {
+        return;
+    }
+
+    for (cpuid_t cpu_id = 0; cpu_id < PLAT_CPU_NUM; cpu_id++) {
+        if (vm->cpus & (1UL << cpu_id)) {
+            while (!boot_prof[cpu_id].done) { }
+        }
+    }
+    fence_ord_read();
+
+    /**
+     * Start offsets are relative to the master CPU entry in init. As the timer is system wide,
+     * they are comparable across CPUs.
+     */
+    console_printk("BOOTPROF\tfreq\t%lu\n", (unsigned long)timestamp_freq());
+    console_printk("BOOTPROF\tvm\tcpu\tphase\tstart\tticks\tcount\n");
+    for (cpuid_t cpu_id = 0; cpu_id < PLAT_CPU_NUM; cpu_id++) {
+        if (!(vm->cpus & (1UL << cpu_id))) {
+            continue;
+        }
+        struct boot_prof_cpu* cpu_prof = &boot_prof[cpu_id];
+        boot_prof_print_row(vm->id, cpu_id, "entry", cpu_prof->entry, 0, 1);
+        for (size_t phase = 0; phase < BOOT_PROF_PHASE_NUM; phase++) {
+            if (cpu_prof->count[phase] > 0) {
+                boot_prof_print_row(vm->id, cpu_id, boot_prof_phase_name[phase],
+                    cpu_prof->first[phase], cpu_prof->ticks[phase], cpu_prof->count[phase]);
+            }
+        }
+        boot_prof_print_row(vm->id, cpu_id, "vcpu_run", cpu_prof->vcpu_run,
+            cpu_prof->vcpu_run - cpu_prof->entry, 1);
+    }
+}
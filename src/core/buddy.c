@@ -0,0 +1,222 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <mem.h>
+
+/**
+ * Buddy allocator for page pools. The page pool bitmap remains the authoritative per-page state
+ * used by reservations, colored allocations and frees. On top of it, for each order k, a bitmap
+ * marks which blocks of 2^k pages are free and not part of a larger free block, i.e., the buddy
+ * free lists are kept as bitmaps. Blocks are numbered by physical frame number (pfn >> k), not by
+ * pool index, so any order k block is also physically aligned to its size, as needed for block
+ * mappings. Block bits for blocks that cross the pool boundaries are never set.
+ *
+ * All functions must be called with the pool lock held.
+ */
+
+static inline size_t pp_buddy_pfn(struct page_pool* pool)
+{
+    return pool->base / PAGE_SIZE;
+}
+
+static inline size_t pp_buddy_first(struct page_pool* pool, size_t order)
+{
+    return pp_buddy_pfn(pool) >> order;
+}
+
+static inline size_t pp_buddy_len(struct page_pool* pool, size_t order)
+{
+    if (pool->size == 0) {
+        return 0;
+    }
+
+    size_t first = pp_buddy_pfn(pool);
+    size_t last = first + pool->size - 1;
+    return (last >> order) - (first >> order) + 1;
+}
+
+static inline bool pp_buddy_is_free(struct page_pool* pool, size_t order, size_t blk)
+{
+    size_t first = pp_buddy_first(pool, order);
+    if ((blk < first) || ((blk - first) >= pool->buddy.len[order])) {
+        return false;
+    }
+    return bitmap_get(pool->buddy.free[order], blk - first) != 0;
+}
+
+static inline void pp_buddy_set(struct page_pool* pool, size_t order, size_t blk)
+{
+    size_t bit = blk - pp_buddy_first(pool, order);
+    bitmap_set(pool->buddy.free[order], bit);
+    if (bit < pool->buddy.hint[order]) {
+        pool->buddy.hint[order] = bit;
+    }
+}
+
+static inline void pp_buddy_clear(struct page_pool* pool, size_t order, size_t blk)
+{
+    bitmap_clear(pool->buddy.free[order], blk - pp_buddy_first(pool, order));
+}
+
+/**
+ * Returns the largest order of a block starting at pfn that does not exceed num_pages.
+ */
+static inline size_t pp_buddy_fit_order(size_t pfn, size_t num_pages)
+{
+    size_t order = 0;
+    while ((order < PP_BUDDY_MAX_ORDER) && !(pfn & (1UL << order)) &&
+        ((2UL << order) <= num_pages)) {
+        order++;
+    }
+    return order;
+}
+
+static void pp_buddy_free_block(struct page_pool* pool, size_t pfn, size_t order)
+{
+    size_t blk = pfn >> order;
+
+    /* Coalesce with the buddy for as long as it is free */
+    while ((order < PP_BUDDY_MAX_ORDER) && pp_buddy_is_free(pool, order, blk ^ 1)) {
+        pp_buddy_clear(pool, order, blk ^ 1);
+        blk >>= 1;
+        order++;
+    }
+
+    pp_buddy_set(pool, order, blk);
+}
+
+static void pp_buddy_free_range(struct page_pool* pool, size_t pfn, size_t num_pages)
+{
+    while (num_pages > 0) {
+        size_t order = pp_buddy_fit_order(pfn, num_pages);
+        pp_buddy_free_block(pool, pfn, order);
+        pfn += 1UL << order;
+        num_pages -= 1UL << order;
+    }
+}
+
+/**
+ * Returns the order of the free block containing pfn, or -1 if the page is not free.
+ */
+static ssize_t pp_buddy_find_block(struct page_pool* pool, size_t pfn)
+{
+    for (size_t order = 0; order <= PP_BUDDY_MAX_ORDER; order++) {
+        if (pp_buddy_is_free(pool, order, pfn >> order)) {
+            return (ssize_t)order;
+        }
+    }
+    return -1;
+}
+
+size_t pp_buddy_size(struct page_pool* pool)
+{
+    size_t size = 0;
+    for (size_t order = 0; order <= PP_BUDDY_MAX_ORDER; order++) {
+        size += BITMAP_SIZE(pp_buddy_len(pool, order)) * sizeof(bitmap_granule_t);
+    }
+    return size;
+}
+
+void pp_buddy_init(struct page_pool* pool, void* maps)
+{
+    bitmap_t* map = (bitmap_t*)maps;
+
+    for (size_t order = 0; order <= PP_BUDDY_MAX_ORDER; order++) {
+        pool->buddy.free[order] = map;
+        pool->buddy.len[order] = pp_buddy_len(pool, order);
+        pool->buddy.hint[order] = pool->buddy.len[order];
+        map += BITMAP_SIZE(pool->buddy.len[order]);
+    }
+
+    pp_buddy_free_range(pool, pp_buddy_pfn(pool), pool->size);
+}
+
+bool pp_buddy_alloc(struct page_pool* pool, size_t num_pages, bool aligned, size_t* index)
+{
+    size_t order = 0;
+    while ((order <= PP_BUDDY_MAX_ORDER) && ((1UL << order) < num_pages)) {
+        order++;
+    }
+
+    /**
+     * Blocks are always aligned to their size, so we can't serve alignments to a size that is not
+     * a power of two. These, and requests larger than the largest block, are left for the caller to
+     * search in the page bitmap.
+     */
+    if ((order > PP_BUDDY_MAX_ORDER) || (aligned && ((1UL << order) != num_pages))) {
+        return false;
+    }
+
+    for (size_t k = order; k <= PP_BUDDY_MAX_ORDER; k++) {
+        ssize_t bit =
+            bitmap_find_next_set(pool->buddy.free[k], pool->buddy.len[k], pool->buddy.hint[k]);
+        if (bit < 0) {
+            pool->buddy.hint[k] = pool->buddy.len[k];
+            continue;
+        }
+        pool->buddy.hint[k] = (size_t)bit;
+
+        /* Split the block down to the requested order, freeing the upper halves */
+        size_t blk = pp_buddy_first(pool, k) + (size_t)bit;
+        pp_buddy_clear(pool, k, blk);
+        while (k > order) {
+            k--;
+            blk <<= 1;
+            pp_buddy_set(pool, k, blk | 1);
+        }
+
+        /* Give back the pages we rounded the request up with */
+        size_t pfn = blk << order;
+        pp_buddy_free_range(pool, pfn + num_pages, (1UL << order) - num_pages);
+
+        *index = pfn - pp_buddy_pfn(pool);
+        return true;
+    }
+
+    return false;
+}
+
+void pp_buddy_reserve(struct page_pool* pool, size_t index, size_t num_pages)
+{
+    size_t end = index + num_pages;
+    size_t end_pfn = pp_buddy_pfn(pool) + end;
+    ssize_t i = bitmap_find_next_clear(pool->bitmap, end, index);
+
+    while (i >= 0) {
+        size_t pfn = pp_buddy_pfn(pool) + (size_t)i;
+        size_t next = (size_t)i + 1;
+        ssize_t order = pp_buddy_find_block(pool, pfn);
+
+        if (order >= 0) {
+            /**
+             * Take the whole block containing the page out and give back the pages on either side
+             * of the reserved range.
+             */
+            size_t blk_pfn = (pfn >> order) << order;
+            size_t blk_end = blk_pfn + (1UL << order);
+            pp_buddy_clear(pool, (size_t)order, pfn >> order);
+            pp_buddy_free_range(pool, blk_pfn, pfn - blk_pfn);
+            if (end_pfn < blk_end) {
+                pp_buddy_free_range(pool, end_pfn, blk_end - end_pfn);
+            }
+            next = min(blk_end, end_pfn) - pp_buddy_pfn(pool);
+        }
+
+        i = bitmap_find_next_clear(pool->bitmap, end, next);
+    }
+}
+
+void pp_buddy_release(struct page_pool* pool, size_t index, size_t num_pages)
+{
+    size_t end = index + num_pages;
+    ssize_t i = bitmap_find_next_set(pool->bitmap, end, index);
+
+    /* Only give back the pages that are actually allocated */
+    while (i >= 0) {
+        size_t run = bitmap_count_consecutive(pool->bitmap, end, (size_t)i, end - (size_t)i);
+        pp_buddy_free_range(pool, pp_buddy_pfn(pool) + (size_t)i, run);
+        i = bitmap_find_next_set(pool->bitmap, end, (size_t)i + run);
+    }
+}
@@ -9,14 +9,122 @@
 #include <platform.h>
 #include <cpu.h>
 #include <mem.h>
+#include <interrupts.h>
 #include <fences.h>
-#include <spinlock.h>
+#include <atomic.h>
 #include <printk.h>
 #include <util.h>
 
 static volatile bao_uart_t* uart;
 static bool console_ready = false;
-static spinlock_t console_lock = SPINLOCK_INITVAL;
+static irqid_t console_irq_id = INVALID_IRQID;
+
+/**
+ * Output is appended to a ring shared by all cpus and written to the uart by a single drainer at a
+ * time. Producers reserve space by advancing ring_reserved and publish it, in reservation order,
+ * by advancing ring_committed. The drainer advances ring_drained. Indexes grow monotonically and
+ * are wrapped on access, so the ring size must be a power of two.
+ */
+#define CONSOLE_RING_SIZE (4096UL)
+
+static char console_ring[CONSOLE_RING_SIZE];
+static volatile unsigned long ring_reserved;
+static volatile unsigned long ring_committed;
+static volatile unsigned long ring_drained;
+static volatile unsigned long console_draining;
+
+static inline bool console_ring_pending(void)
+{
+    return atomic_load_acquire(&ring_committed) != atomic_load_relaxed(&ring_drained);
+}
+
+/**
+ * Writes committed output to the uart. Only one cpu drains at a time and any other returns
+ * immediately, as the owner keeps draining whatever is committed meanwhile. If block is false, it
+ * stops as soon as the uart can take no more characters, leaving the rest to the transmit
+ * interrupt or to an idle cpu. Otherwise, it waits on the uart until the ring is drained up to
+ * until, and only writes output committed after that for as long as the uart takes it right away.
+ */
+static void console_drain(bool block, unsigned long until)
+{
+    do {
+        if (atomic_exchange(&console_draining, 1) != 0) {
+            return;
+        }
+
+        unsigned long drained = atomic_load_relaxed(&ring_drained);
+        unsigned long committed = atomic_load_acquire(&ring_committed);
+        while (drained != committed) {
+            if (!uart_tx_ready(uart)) {
+                if (!block || ((long)(until - drained) <= 0)) {
+                    break;
+                }
+                continue;
+            }
+            uart_putc(uart, (int8_t)console_ring[drained % CONSOLE_RING_SIZE]);
+            drained += 1;
+            atomic_store_release(&ring_drained, drained);
+            if (drained == committed) {
+                committed = atomic_load_acquire(&ring_committed);
+            }
+        }
+
+        if (console_irq_id != INVALID_IRQID) {
+            uart_tx_irq_enable(uart, drained != committed);
+        }
+
+        atomic_store_release(&console_draining, 0);
+
+        /**
+         * Output committed after the last check but before ownership was released would otherwise
+         * be left behind, as its producer found the drainer busy.
+         */
+    } while (console_ring_pending() &&
+        ((block && ((long)(until - atomic_load_relaxed(&ring_drained)) > 0)) ||
+            uart_tx_ready(uart)));
+}
+
+/* Returns the ring position right after the pushed output */
+static unsigned long console_ring_push(const char* buf, size_t n)
+{
+    size_t len = n;
+    for (size_t i = 0; i < n; i++) {
+        if (buf[i] == '\n') {
+            len += 1;
+        }
+    }
+
+    unsigned long start = atomic_load_relaxed(&ring_reserved);
+    do {
+        while ((start + len - atomic_load_acquire(&ring_drained)) > CONSOLE_RING_SIZE) {
+            /* The ring is full, so wait on the uart for room. */
+            console_drain(true, start + len - CONSOLE_RING_SIZE);
+            start = atomic_load_relaxed(&ring_reserved);
+        }
+    } while (!atomic_cas(&ring_reserved, &start, start + len));
+
+    unsigned long pos = start;
+    for (size_t i = 0; i < n; i++) {
+        if (buf[i] == '\n') {
+            console_ring[pos++ % CONSOLE_RING_SIZE] = '\r';
+        }
+        console_ring[pos++ % CONSOLE_RING_SIZE] = buf[i];
+    }
+
+    /* Publish in reservation order, after the producers that reserved before us. */
+    while (atomic_load_acquire(&ring_committed) != start) { }
+    atomic_store_release(&ring_committed, start + len);
+
+    return start + len;
+}
+
+static void console_irq_handler(irqid_t int_id)
+{
+    UNUSED_ARG(int_id);
+
+    uart_clear_irqs(uart);
+    console_drain(false, 0);
+}
 
 void console_init(void)
 {
@@ -39,33 +147,70 @@ void console_init(void)
     cpu_sync_and_clear_msgs(&cpu_glb_sync);
 }
 
+void console_irq_init(void)
+{
+    if (DEFINED(CONSOLE_IRQ) && cpu_is_master() && (platform.console.irq_id != 0)) {
+        irqid_t irq_id = interrupts_reserve(platform.console.irq_id, console_irq_handler);
+        if (irq_id == INVALID_IRQID) {
+            WARNING("failed to reserve console interrupt");
+        } else {
+            uart_clear_irqs(uart);
+            interrupts_cpu_enable(irq_id, true);
+            console_irq_id = irq_id;
+        }
+    }
+}
+
 void console_write(const char* buf, size_t n)
 {
     while (!console_ready)
         ;
-    for (size_t i = 0; i < n; i++) {
-        if (buf[i] == '\n') {
-            uart_putc(uart, '\r');
+    unsigned long end = console_ring_push(buf, n);
+
+    /**
+     * With a transmit interrupt, only write what the uart takes right away. Otherwise, idle cpus
+     * might never come around to drain the ring, so wait on the uart until this output is out,
+     * but not for the output other cpus commit meanwhile.
+     */
+    if (console_irq_id != INVALID_IRQID) {
+        console_drain(false, 0);
+    } else {
+        while ((long)(end - atomic_load_acquire(&ring_drained)) > 0) {
+            console_drain(true, end);
         }
-        uart_putc(uart, (int8_t)buf[i]);
+    }
+}
+
+void console_flush(void)
+{
+    while (!console_ready)
+        ;
+    while (console_ring_pending()) {
+        console_drain(true, atomic_load_acquire(&ring_committed));
+    }
+}
+
+void console_idle_drain(void)
+{
+    while (console_ring_pending() && !interrupts_check(interrupts_ipi_id)) {
+        console_drain(false, 0);
     }
 }
 
 #define PRINTF_BUFFER_LEN (256)
-static char console_bufffer[PRINTF_BUFFER_LEN];
+static char console_buffer[PLAT_CPU_NUM][PRINTF_BUFFER_LEN];
 
 __attribute__((format(printf, 1, 2))) void console_printk(const char* fmt, ...)
 {
     va_list args;
     size_t chars_writen;
     const char* fmt_it = fmt;
+    char* buffer = console_buffer[cpu()->id];
 
     va_start(args, fmt);
-    spin_lock(&console_lock);
     while (*fmt_it != '\0') {
-        chars_writen = vsnprintk(console_bufffer, PRINTF_BUFFER_LEN, &fmt_it, &args);
-        console_write(console_bufffer, min(PRINTF_BUFFER_LEN, chars_writen));
+        chars_writen = vsnprintk(buffer, PRINTF_BUFFER_LEN, &fmt_it, &args);
+        console_write(buffer, min(PRINTF_BUFFER_LEN, chars_writen));
     }
-    spin_unlock(&console_lock);
     va_end(args);
 }
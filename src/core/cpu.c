@@ -6,21 +6,12 @@
 #include <cpu.h>
 #include <interrupts.h>
 #include <platform.h>
-#include <objpool.h>
 #include <vm.h>
 #include <fences.h>
+#include <atomic.h>
+#include <trace.h>
 
-struct cpu_msg_node {
-    node_t node;
-    struct cpu_msg msg;
-};
-
-#define CPU_MSG_POOL_SIZE_DEFAULT (128)
-#ifndef CPU_MSG_POOL_SIZE
-#define CPU_MSG_POOL_SIZE CPU_MSG_POOL_SIZE_DEFAULT
-#endif
-
-OBJPOOL_ALLOC(msg_pool, struct cpu_msg_node, CPU_MSG_POOL_SIZE);
+#define CPU_MSG_QUEUE_MASK (CPU_MSG_QUEUE_SIZE - 1)
 
 struct cpu_synctoken cpu_glb_sync = { .ready = false };
 
@@ -31,6 +22,17 @@ static size_t ipi_cpumsg_handler_num;
 
 struct cpuif cpu_interfaces[PLAT_CPU_NUM];
 
+static void cpu_msg_queue_init(struct cpuif* interface)
+{
+    interface->msg_tail = 0;
+    interface->msg_doorbell = 0;
+    interface->msg_head = 0;
+    interface->msg_stats = (struct cpu_msg_stats){ 0 };
+    for (size_t i = 0; i < CPU_MSG_QUEUE_SIZE; i++) {
+        interface->msg_queue[i].seq = 0;
+    }
+}
+
 void cpu_init(cpuid_t cpu_id, paddr_t load_addr)
 {
     cpu()->id = cpu_id;
@@ -39,7 +41,7 @@ void cpu_init(cpuid_t cpu_id, paddr_t load_addr)
 
     cpu_arch_init(cpu_id, load_addr);
 
-    list_init(&cpu()->interface->event_list);
+    cpu_msg_queue_init(cpu()->interface);
 
     if (cpu_is_master()) {
         cpu_sync_init(&cpu_glb_sync, platform.cpu_num);
@@ -54,34 +56,160 @@ void cpu_init(cpuid_t cpu_id, paddr_t load_addr)
     cpu_sync_barrier(&cpu_glb_sync);
 }
 
+/**
+ * The message queue is a bounded multi-producer single-consumer ring (following Vyukov's bounded
+ * queue design). Producers claim a position by advancing the tail with a CAS, fill the slot and
+ * publish it by updating its sequence number. The owner cpu is the only consumer, so the head
+ * needs no synchronization other than the slots' sequence numbers. A slot's sequence number is
+ * kept as the "lap base" (i.e., position & ~CPU_MSG_QUEUE_MASK) it is waiting for, plus one when
+ * it holds a published message.
+ */
+
+static inline long cpu_msg_slot_state(struct cpu_msg_slot* slot, unsigned long pos)
+{
+    return (long)(atomic_load_acquire(&slot->seq) - (pos & ~(unsigned long)CPU_MSG_QUEUE_MASK));
+}
+
+static bool cpu_msg_enqueue(struct cpuif* interface, struct cpu_msg* msg)
+{
+    struct cpu_msg_slot* slot = NULL;
+    unsigned long pos = atomic_load_relaxed(&interface->msg_tail);
+
+    while (true) {
+        slot = &interface->msg_queue[pos & CPU_MSG_QUEUE_MASK];
+        long state = cpu_msg_slot_state(slot, pos);
+        if (state == 0) {
+            if (atomic_cas(&interface->msg_tail, &pos, pos + 1)) {
+                break;
+            }
+        } else if (state < 0) {
+            /* The slot still holds the message from the previous lap: the queue is full */
+            return false;
+        } else {
+            pos = atomic_load_relaxed(&interface->msg_tail);
+        }
+    }
+
+    slot->msg = *msg;
+    atomic_store_release(&slot->seq, (pos & ~(unsigned long)CPU_MSG_QUEUE_MASK) + 1);
+
+    return true;
+}
+
+static void cpu_msg_enqueue_wait(cpuid_t trgtcpu, struct cpu_msg* msg)
+{
+    while (!cpu_msg_enqueue(cpu_if(trgtcpu), msg)) {
+        /**
+         * The target will drain its queue as soon as it handles the already pending IPI. Handlers
+         * are never run from here, as the caller might hold locks they take, so a cpu cannot wait
+         * for room in its own queue.
+         */
+        if (trgtcpu == cpu()->id) {
+            ERROR("cpu %d message queue full", cpu()->id);
+        }
+    }
+}
+
+/**
+ * Must be called after the message was published. The doorbell exchange pairs with the one in
+ * cpu_msg_handler: either we see the doorbell still pending and the target is guaranteed to see
+ * our message when it drains the queue, or we are the ones raising the IPI.
+ */
+static inline bool cpu_msg_doorbell(cpuid_t trgtcpu)
+{
+    bool ring = atomic_exchange(&cpu_if(trgtcpu)->msg_doorbell, 1) == 0;
+    if (ring) {
+        cpu()->interface->msg_stats.ipis_sent++;
+    } else {
+        cpu()->interface->msg_stats.ipis_coalesced++;
+    }
+    return ring;
+}
+
+static inline void cpu_msg_trace_send(cpuid_t trgtcpu, struct cpu_msg* msg)
+{
+    trace_event(TRACE_MSG_SEND, (uint32_t)trgtcpu, ((uint64_t)msg->handler << 32) | msg->event);
+}
+
+bool cpu_try_send_msg(cpuid_t trgtcpu, struct cpu_msg* msg)
+{
+    if (!cpu_msg_enqueue(cpu_if(trgtcpu), msg)) {
+        return false;
+    }
+    cpu_msg_trace_send(trgtcpu, msg);
+
+    if (cpu_msg_doorbell(trgtcpu)) {
+        fence_sync_write();
+        interrupts_cpu_sendipi(trgtcpu, interrupts_ipi_id);
+    }
+
+    return true;
+}
+
 void cpu_send_msg(cpuid_t trgtcpu, struct cpu_msg* msg)
 {
-    struct cpu_msg_node* node = objpool_alloc(&msg_pool);
-    if (node == NULL) {
-        ERROR("cant allocate msg node");
+    cpu_msg_enqueue_wait(trgtcpu, msg);
+    cpu_msg_trace_send(trgtcpu, msg);
+
+    if (cpu_msg_doorbell(trgtcpu)) {
+        fence_sync_write();
+        interrupts_cpu_sendipi(trgtcpu, interrupts_ipi_id);
+    }
+}
+
+void cpu_send_msg_multicast(cpumap_t cpus, struct cpu_msg* msg)
+{
+    cpumap_t ipi_targets = 0;
+
+    for (cpuid_t i = 0; i < platform.cpu_num; i++) {
+        if (cpus & (1UL << i)) {
+            cpu_msg_enqueue_wait(i, msg);
+            cpu_msg_trace_send(i, msg);
+            if (cpu_msg_doorbell(i)) {
+                ipi_targets |= (1UL << i);
+            }
+        }
+    }
+
+    if (ipi_targets != 0) {
+        fence_sync_write();
+        for (cpuid_t i = 0; i < platform.cpu_num; i++) {
+            if (ipi_targets & (1UL << i)) {
+                interrupts_cpu_sendipi(i, interrupts_ipi_id);
+            }
+        }
     }
-    node->msg = *msg;
-    list_push(&cpu_if(trgtcpu)->event_list, (node_t*)node);
-    fence_sync_write();
-    interrupts_cpu_sendipi(trgtcpu, interrupts_ipi_id);
 }
 
 bool cpu_get_msg(struct cpu_msg* msg)
 {
-    struct cpu_msg_node* node = NULL;
-    if ((node = (struct cpu_msg_node*)list_pop(&cpu()->interface->event_list)) != NULL) {
-        *msg = node->msg;
-        objpool_free(&msg_pool, node);
-        return true;
+    struct cpuif* interface = cpu()->interface;
+    unsigned long pos = interface->msg_head;
+    struct cpu_msg_slot* slot = &interface->msg_queue[pos & CPU_MSG_QUEUE_MASK];
+
+    if (cpu_msg_slot_state(slot, pos) != 1) {
+        return false;
     }
-    return false;
+
+    *msg = slot->msg;
+    atomic_store_release(&slot->seq,
+        (pos & ~(unsigned long)CPU_MSG_QUEUE_MASK) + CPU_MSG_QUEUE_SIZE);
+    interface->msg_head = pos + 1;
+
+    return true;
 }
 
 void cpu_msg_handler(void)
 {
     cpu()->handling_msgs = true;
+    /**
+     * Clear the doorbell before draining so that any message published after the queue is found
+     * empty comes with a new IPI.
+     */
+    atomic_exchange(&cpu()->interface->msg_doorbell, 0);
     struct cpu_msg msg;
     while (cpu_get_msg(&msg)) {
+        trace_event(TRACE_MSG_RECV, msg.handler, msg.event);
         if (msg.handler < ipi_cpumsg_handler_num && ipi_cpumsg_handlers[msg.handler]) {
             ipi_cpumsg_handlers[msg.handler](msg.event, msg.data);
         }
@@ -91,6 +219,8 @@ void cpu_msg_handler(void)
 
 void cpu_idle(void)
 {
+    console_idle_drain();
+
     cpu_arch_idle();
 
     /**
@@ -7,19 +7,40 @@
 #include <cpu.h>
 #include <vm.h>
 #include <ipc.h>
+#include <trap_stats.h>
+#include <vconsole.h>
+#include <memguard.h>
 
 long int hypercall(unsigned long id)
 {
     long int ret = -HC_E_INVAL_ID;
 
-    unsigned long ipc_id = vcpu_readreg(cpu()->vcpu, HYPCALL_ARG_REG(0));
+    unsigned long arg0 = vcpu_readreg(cpu()->vcpu, HYPCALL_ARG_REG(0));
     unsigned long arg1 = vcpu_readreg(cpu()->vcpu, HYPCALL_ARG_REG(1));
     unsigned long arg2 = vcpu_readreg(cpu()->vcpu, HYPCALL_ARG_REG(2));
 
     switch (id) {
         case HC_IPC:
-            ret = ipc_hypercall(ipc_id, arg1, arg2);
+            ret = ipc_hypercall(arg0, arg1, arg2);
             break;
+#ifdef TRAP_STATS
+        case HC_TRAP_STATS:
+            ret = trap_stats_hypercall(arg0, arg1);
+            break;
+#endif
+        case HC_VCONSOLE:
+            ret = vconsole_hypercall();
+            break;
+#ifdef MEM_PROT_MMU
+        case HC_RECOLOR:
+            ret = vm_recolor_hypercall(arg0, arg1, arg2);
+            break;
+#endif
+#ifdef MEMGUARD
+        case HC_MEMGUARD:
+            ret = memguard_hypercall(arg0, arg1);
+            break;
+#endif
         default:
             WARNING("Unknown hypercall id %d", id);
     }
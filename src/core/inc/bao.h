@@ -20,6 +20,7 @@
 
 #define ERROR(...)                             \
     console_printk("BAO ERROR: " __VA_ARGS__); \
+    console_flush();                           \
     while (true) { };
 
 void init(cpuid_t cpu_id, paddr_t load_addr);
@@ -0,0 +1,62 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __BOOT_PROF_H__
+#define __BOOT_PROF_H__
+
+#include <bao.h>
+
+/**
+ * Boot profiler. When built with BOOT_PROF=y, each CPU records how long it spends in each of the
+ * phases below, from init until it first runs its vcpu, and the VM master prints a table with the
+ * results for all the VM's CPUs before running the guest. Otherwise, all hooks compile to nothing.
+ */
+
+enum boot_prof_phase {
+    BOOT_PROF_MEM_INIT,
+    BOOT_PROF_VMM_ASSIGN_VCPU,
+    BOOT_PROF_VM_INIT_MEM_REGIONS,
+    BOOT_PROF_VM_INSTALL_IMAGE,
+    BOOT_PROF_MEM_MAP_RECLR,
+    BOOT_PROF_VIRQC_INIT,
+    BOOT_PROF_SYNC_WAIT,
+    BOOT_PROF_PHASE_NUM
+};
+
+struct vm;
+
+#ifdef BOOT_PROF
+
+uint64_t boot_prof_begin(void);
+void boot_prof_end(enum boot_prof_phase phase, uint64_t begin);
+void boot_prof_start(uint64_t entry);
+void boot_prof_report(struct vm* vm);
+
+#else
+
+static inline uint64_t boot_prof_begin(void)
+{
+    return 0;
+}
+
+static inline void boot_prof_end(enum boot_prof_phase phase, uint64_t begin)
+{
+    UNUSED_ARG(phase);
+    UNUSED_ARG(begin);
+}
+
+static inline void boot_prof_start(uint64_t entry)
+{
+    UNUSED_ARG(entry);
+}
+
+static inline void boot_prof_report(struct vm* vm)
+{
+    UNUSED_ARG(vm);
+}
+
+#endif
+
+#endif /* __BOOT_PROF_H__ */
@@ -19,6 +19,12 @@ struct cache {
     size_t numset[CACHE_MAX_LVL][2];
 };
 
+/**
+ * Upper bound of the cache line size of the supported platforms. Data written by different cpus
+ * is aligned to it so that it never shares a cache line.
+ */
+#define CACHE_LINE_SIZE_MAX (64)
+
 extern size_t COLOR_NUM;
 extern size_t COLOR_SIZE;
 
@@ -74,6 +74,14 @@ struct vm_config {
         bool separately_loaded;
         /* Dont copy the image */
         bool inplace;
+        /**
+         * Map the image in place and read-only, so that VMs loading the same image share its
+         * pages. A VM gets a private copy of a page the first time it writes to it. Only
+         * meaningful for MMU-based platforms and VMs without colors, as colored VMs always get
+         * their own recolored copy. Thus, a colored VM must not load its image at the same
+         * address as any other VM.
+         */
+        bool shared;
     } image;
 
     /* Entry point address in VM's address space */
@@ -91,6 +99,22 @@ struct vm_config {
      */
     colormap_t colors;
 
+    /**
+     * Allows the VM to move other VMs' memory to different colors at runtime through the
+     * HC_RECOLOR hypercall. Only meaningful for MMU-based platforms.
+     */
+    bool color_mgmt;
+
+    /**
+     * Memory bandwidth regulation, only available when built with MEMGUARD=y. Each of the VM's cpus
+     * may generate up to budget memory events, e.g., cache refills, every period_us microseconds
+     * before being throttled until the next period. Left unregulated if budget is zero.
+     */
+    struct {
+        uint32_t budget;
+        uint32_t period_us;
+    } memguard;
+
     /**
      * A description of the virtual platform available to the guest, i.e., the virtual machine
      * itself.
@@ -126,6 +150,12 @@ extern struct config {
 
 } config;
 
+/* Colored vms always get their own recolored copy of the image, so they never share it */
+static inline bool config_vm_img_shared(const struct vm_config* vm_config)
+{
+    return DEFINED(MEM_PROT_MMU) && vm_config->image.shared && all_clrs(vm_config->colors);
+}
+
 void config_init(paddr_t load_addr);
 void config_mem_prot_init(paddr_t load_addr);
 
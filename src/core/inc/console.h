@@ -9,7 +9,10 @@
 #include <bao.h>
 
 void console_init(void);
+void console_irq_init(void);
 void console_write(const char* buf, size_t n);
 void console_printk(const char* fmt, ...);
+void console_flush(void);
+void console_idle_drain(void);
 
 #endif /* __CONSOLE_H__ */
@@ -12,11 +12,56 @@
 #include <spinlock.h>
 #include <mem.h>
 #include <list.h>
+#include <boot_prof.h>
 
 #ifndef __ASSEMBLER__
 
+#define CPU_MSG_QUEUE_SIZE_DEFAULT (64)
+#ifndef CPU_MSG_QUEUE_SIZE
+#define CPU_MSG_QUEUE_SIZE CPU_MSG_QUEUE_SIZE_DEFAULT
+#endif
+
+#if (CPU_MSG_QUEUE_SIZE & (CPU_MSG_QUEUE_SIZE - 1)) != 0
+#error "CPU_MSG_QUEUE_SIZE must be a power of two"
+#endif
+
+struct cpu_msg {
+    uint32_t handler;
+    uint32_t event;
+    uint64_t data;
+};
+
+/**
+ * Each slot of the message queue carries a sequence number which tells both producers and the
+ * consumer in which "lap" of the ring the slot currently is, and whether it is free or holds a
+ * published message. It is kept relative to the slot index so that a zeroed queue is a valid empty
+ * queue.
+ */
+struct cpu_msg_slot {
+    volatile unsigned long seq;
+    struct cpu_msg msg;
+};
+
+struct cpu_msg_stats {
+    /* IPIs effectively raised by this cpu */
+    unsigned long ipis_sent;
+    /* IPIs avoided because the target's doorbell was already pending */
+    unsigned long ipis_coalesced;
+};
+
 struct cpuif {
-    struct list event_list;
+    /* Next position to be claimed by any of the producers (i.e., remote cpus) */
+    volatile unsigned long msg_tail;
+    /**
+     * Set by the first producer to enqueue a message after the owner cpu last started draining its
+     * queue. Only that producer raises the IPI, the others rely on it.
+     */
+    volatile unsigned long msg_doorbell;
+    struct cpu_msg_slot msg_queue[CPU_MSG_QUEUE_SIZE];
+    /* Next position to be consumed. Only ever accessed by the owner cpu */
+    unsigned long msg_head;
+    /* Only ever updated by the owner cpu, but read by others, e.g., for trap statistics */
+    struct cpu_msg_stats msg_stats;
 
 } __attribute__((aligned(PAGE_SIZE)));
 
@@ -38,13 +83,6 @@ struct cpu {
     uint8_t stack[STACK_SIZE] __attribute__((aligned(PAGE_SIZE)));
 
 } __attribute__((aligned(PAGE_SIZE)));
-struct cpu_msg {
-    uint32_t handler;
-    uint32_t event;
-    uint64_t data;
-};
-
-void cpu_send_msg(cpuid_t cpu, struct cpu_msg* msg);
 
 typedef void (*cpu_msg_handler_t)(uint32_t event, uint64_t data);
 
@@ -63,7 +101,26 @@ struct cpu_synctoken {
 extern struct cpu_synctoken cpu_glb_sync;
 
 void cpu_init(cpuid_t cpu_id, paddr_t load_addr);
+/**
+ * @brief Sends a message to the target cpu without blocking.
+ *
+ * @param cpu target cpu
+ * @param msg message to deliver
+ * @return true if the message was enqueued, false if the target's message queue is full. In the
+ *         latter case the message is not delivered and it is up to the caller to retry or drop it.
+ */
+bool cpu_try_send_msg(cpuid_t cpu, struct cpu_msg* msg);
+/**
+ * @brief Sends a message to the target cpu, waiting for a free slot in the target's message queue
+ *        if it is full. Callers that cannot wait, e.g., because the target might be waiting on
+ *        them, should use cpu_try_send_msg instead.
+ */
 void cpu_send_msg(cpuid_t cpu, struct cpu_msg* msg);
+/**
+ * @brief Sends the same message to all cpus in a cpu map, waiting for free slots in full queues.
+ *        IPIs are only raised after the message was enqueued on all targets.
+ */
+void cpu_send_msg_multicast(cpumap_t cpus, struct cpu_msg* msg);
 bool cpu_get_msg(struct cpu_msg* msg);
 void cpu_msg_handler(void);
 void cpu_msg_set_handler(cpuid_t id, cpu_msg_handler_t handler);
@@ -97,6 +154,7 @@ static inline void cpu_sync_barrier(struct cpu_synctoken* token)
     // TODO: no fence/barrier needed in this function?
 
     size_t next_count = 0;
+    uint64_t wait_begin = boot_prof_begin();
 
     while (!token->ready) { }
 
@@ -106,11 +164,14 @@ static inline void cpu_sync_barrier(struct cpu_synctoken* token)
     spin_unlock(&token->lock);
 
     while (token->count < next_count) { }
+
+    boot_prof_end(BOOT_PROF_SYNC_WAIT, wait_begin);
 }
 
 static inline void cpu_sync_and_clear_msgs(struct cpu_synctoken* token)
 {
     size_t next_count = 0;
+    uint64_t wait_begin = boot_prof_begin();
 
     while (!token->ready) { }
 
@@ -129,6 +190,8 @@ static inline void cpu_sync_and_clear_msgs(struct cpu_synctoken* token)
         cpu_msg_handler();
     }
 
+    boot_prof_end(BOOT_PROF_SYNC_WAIT, wait_begin);
+
     cpu_sync_barrier(token);
 }
 
@@ -7,7 +7,6 @@
 #define __EMUL_H__
 
 #include <bao.h>
-#include <list.h>
 
 struct emul_access {
     vaddr_t addr;
@@ -23,14 +22,12 @@ struct emul_access {
 typedef bool (*emul_handler_t)(struct emul_access*);
 
 struct emul_mem {
-    node_t node;
     vaddr_t va_base;
     size_t size;
     emul_handler_t handler;
 };
 
 struct emul_reg {
-    node_t node;
     vaddr_t addr;
     emul_handler_t handler;
 };
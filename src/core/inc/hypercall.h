@@ -9,7 +9,14 @@
 #include <bao.h>
 #include <arch/hypercall.h>
 
-enum { HC_INVAL = 0, HC_IPC = 1 };
+enum {
+    HC_INVAL = 0,
+    HC_IPC = 1,
+    HC_TRAP_STATS = 2,
+    HC_VCONSOLE = 3,
+    HC_RECOLOR = 4,
+    HC_MEMGUARD = 5,
+};
 
 enum { HC_E_SUCCESS = 0, HC_E_FAILURE = 1, HC_E_INVAL_ID = 2, HC_E_INVAL_ARGS = 3 };
 
@@ -21,6 +21,22 @@ struct ppages {
     colormap_t colors;
 };
 
+#ifdef PP_BUDDY
+/* Largest buddy block, 1GiB with 4KiB pages, the largest block mapping used for guest memory */
+#ifndef PP_BUDDY_MAX_ORDER
+#define PP_BUDDY_MAX_ORDER (18)
+#endif
+
+struct pp_buddy {
+    bitmap_t* free[PP_BUDDY_MAX_ORDER + 1];
+    size_t len[PP_BUDDY_MAX_ORDER + 1];
+    size_t hint[PP_BUDDY_MAX_ORDER + 1];
+};
+#endif
+
+/* Maximum number of colors a colormap_t can describe */
+#define PP_CLR_MAX (sizeof(colormap_t) * 8)
+
 struct page_pool {
     node_t node;
     paddr_t base;
@@ -28,6 +44,17 @@ struct page_pool {
     size_t free;
     size_t last;
     bitmap_t* bitmap;
+    /**
+     * Per-color allocation bitmaps, one after the other, each of clr_len bits. Bit j of a color's
+     * bitmap is the j-th page of that color counting from the color period the pool starts in.
+     * They are only set up when the platform has more than one color.
+     */
+    bitmap_t* clr_bitmap;
+    size_t clr_len;
+    size_t clr_hint[PP_CLR_MAX];
+#ifdef PP_BUDDY
+    struct pp_buddy buddy;
+#endif
     spinlock_t lock;
 };
 
@@ -45,6 +72,8 @@ struct shmem {
         paddr_t base;
         paddr_t phys;
     };
+    /* Holds the hypervisor trace rings when built with TRACE=y, see trace.h */
+    bool trace;
     cpumap_t cpu_masters;
     spinlock_t lock;
 };
@@ -61,6 +90,54 @@ static inline bool all_clrs(colormap_t clrs)
     return (masked_colors == 0) || (masked_colors == mask);
 }
 
+#ifdef PP_BUDDY
+size_t pp_buddy_size(struct page_pool* pool);
+void pp_buddy_init(struct page_pool* pool, void* maps);
+bool pp_buddy_alloc(struct page_pool* pool, size_t num_pages, bool aligned, size_t* index);
+void pp_buddy_reserve(struct page_pool* pool, size_t index, size_t num_pages);
+void pp_buddy_release(struct page_pool* pool, size_t index, size_t num_pages);
+#endif
+
+size_t pp_clr_size(struct page_pool* pool);
+void pp_clr_init(struct page_pool* pool, void* maps);
+void pp_clr_mark(struct page_pool* pool, size_t index, size_t num_pages, bool alloced);
+
+/**
+ * Mark a contiguous range of pool pages as allocated or free in the pool bitmap and buddy state,
+ * but not in the per-color bitmaps. Only meant for code that updates those itself.
+ */
+static inline void pp_mark_pages(struct page_pool* pool, size_t index, size_t num_pages,
+    bool alloced)
+{
+    if (alloced) {
+#ifdef PP_BUDDY
+        pp_buddy_reserve(pool, index, num_pages);
+#endif
+        bitmap_set_consecutive(pool->bitmap, index, num_pages);
+    } else {
+#ifdef PP_BUDDY
+        pp_buddy_release(pool, index, num_pages);
+#endif
+        bitmap_clear_consecutive(pool->bitmap, index, num_pages);
+    }
+}
+
+/**
+ * Mark pages of a pool as allocated or free. Must be used instead of changing the pool bitmap
+ * directly, so that the per-color and buddy allocator state is kept in sync with it.
+ */
+static inline void pp_mark_alloced(struct page_pool* pool, size_t index, size_t num_pages)
+{
+    pp_mark_pages(pool, index, num_pages, true);
+    pp_clr_mark(pool, index, num_pages, true);
+}
+
+static inline void pp_mark_free(struct page_pool* pool, size_t index, size_t num_pages)
+{
+    pp_mark_pages(pool, index, num_pages, false);
+    pp_clr_mark(pool, index, num_pages, false);
+}
+
 void mem_init(paddr_t load_addr);
 void* mem_alloc_page(size_t num_pages, enum AS_SEC sec, bool phys_aligned);
 struct ppages mem_alloc_ppages(colormap_t colors, size_t num_pages, bool aligned);
@@ -73,7 +150,22 @@ bool mem_map_reclr(struct addr_space* as, vaddr_t va, struct ppages* ppages, siz
     mem_flags_t flags);
 vaddr_t mem_map_cpy(struct addr_space* ass, struct addr_space* asd, vaddr_t vas, vaddr_t vad,
     size_t num_pages);
+void mem_write_protect(struct addr_space* as, vaddr_t va, size_t num_pages);
+/**
+ * Gives the vm a private, writable copy of the read-only page mapped at va. Returns false if no
+ * page could be allocated.
+ */
+bool mem_cow_page(struct addr_space* as, vaddr_t va);
+/* Tells whether va is mapped in the address space, and writable if write is set */
+bool mem_is_mapped(struct addr_space* as, vaddr_t va, bool write);
+/**
+ * Maps num_pages newly allocated and zeroed pages of the address space colors at va, unless the
+ * range is already taken. Returns false if there are not enough free pages.
+ */
+bool mem_populate(struct addr_space* as, enum AS_SEC section, vaddr_t at, size_t num_pages,
+    mem_flags_t flags);
 bool pp_alloc(struct page_pool* pool, size_t num_pages, bool aligned, struct ppages* ppages);
+size_t pp_bitmap_size(struct page_pool* pool);
 
 void mem_prot_init(void);
 size_t mem_cpu_boot_alloc_size(void);
@@ -0,0 +1,47 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __MEMGUARD_H__
+#define __MEMGUARD_H__
+
+#include <bao.h>
+
+/**
+ * Memory bandwidth regulation. When built with MEMGUARD=y, each cpu running a vm configured with a
+ * memguard budget may only generate that many memory events, as counted by a PMU event, per
+ * period. Once a cpu spends its budget, the PMU overflow interrupt throttles its vcpu, idling the
+ * cpu until the period ends and the budget is replenished. The number of times each vcpu was
+ * throttled, and the ticks it spent throttled, are available to the guest through the HC_MEMGUARD
+ * hypercall.
+ */
+
+enum memguard_stat { MEMGUARD_STAT_COUNT, MEMGUARD_STAT_TICKS };
+
+struct memguard_stats {
+    uint64_t count;
+    uint64_t ticks;
+};
+
+struct vm_config;
+
+#ifdef MEMGUARD
+
+void memguard_init(void);
+void memguard_cpu_init(const struct vm_config* vm_config);
+void memguard_irq_exit(void);
+long int memguard_hypercall(unsigned long vcpu_id, unsigned long stat);
+
+#else
+
+static inline void memguard_init(void) { }
+
+static inline void memguard_cpu_init(const struct vm_config* vm_config)
+{
+    UNUSED_ARG(vm_config);
+}
+
+#endif /* MEMGUARD */
+
+#endif /* __MEMGUARD_H__ */
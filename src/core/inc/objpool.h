@@ -7,31 +7,82 @@
 #define OBJPOOL_H
 
 #include <bao.h>
-#include <bitmap.h>
+#include <platform_defs.h>
 #include <arch/spinlock.h>
+#include <cache.h>
 
+#define OBJPOOL_CPU_CACHE_LEN_DEFAULT (8)
+#ifndef OBJPOOL_CPU_CACHE_LEN
+#define OBJPOOL_CPU_CACHE_LEN OBJPOOL_CPU_CACHE_LEN_DEFAULT
+#endif
+
+/**
+ * Per-cpu cache of free objects. Its lock is only ever taken by other cpus to steal objects when
+ * the shared free list runs out, so allocations and frees served by it do not contend on any
+ * shared state. For the same reason, each cpu counts the objects it hands out and takes back in
+ * its own cache, so the count can go negative for cpus that free objects allocated by others.
+ */
+struct objpool_cache {
+    spinlock_t lock;
+    size_t num;
+    volatile long used;
+    void* objs[OBJPOOL_CPU_CACHE_LEN];
+} __attribute__((aligned(CACHE_LINE_SIZE_MAX)));
+
+/**
+ * The pool is zero-initialized friendly: objects in [fresh, num) were never allocated and free_head
+ * and next[] hold object indexes plus one, zero marking the end of the free list.
+ */
 struct objpool {
     void* pool;
-    bitmap_t* bitmap;
+    size_t* next;
+    struct objpool_cache* caches;
     size_t objsize;
     size_t num;
-    size_t count;
+    size_t cache_len;
+    size_t free_head;
+    size_t fresh;
+    /* Objects allocated without per-cpu caches, the rest are counted in each cache */
+    long used;
+    /* Sampled when caches are refilled and when stats are read, see objpool_get_stats */
+    size_t used_hwm;
     spinlock_t lock;
 };
 
-#define OBJPOOL_ALLOC(NAME, TYPE, N)         \
-    TYPE _##NAME##_array[N];                 \
-    BITMAP_ALLOC(_##NAME##_array_bitmap, N); \
-    struct objpool NAME = {                  \
-        .pool = _##NAME##_array,             \
-        .bitmap = _##NAME##_array_bitmap,    \
-        .objsize = sizeof(TYPE),             \
-        .num = N,                            \
-        .lock = SPINLOCK_INITVAL,            \
+struct objpool_stats {
+    size_t num;
+    /* Objects currently allocated */
+    size_t used;
+    /**
+     * Maximum number of objects allocated at the same time, as sampled whenever a per-cpu cache is
+     * refilled or the stats are read. Peaks served from the caches alone might be missed.
+     */
+    size_t used_hwm;
+};
+
+/**
+ * Per-cpu caches are sized so that, at most, half of the pool objects can be held in them, so that
+ * small pools are not starved by objects sitting in other cpus' caches.
+ */
+#define OBJPOOL_CACHE_LEN(N) min(OBJPOOL_CPU_CACHE_LEN, (N) / (2 * PLAT_CPU_NUM))
+
+#define OBJPOOL_ALLOC(NAME, TYPE, N)                           \
+    TYPE _##NAME##_array[N];                                   \
+    size_t _##NAME##_array_next[N];                            \
+    struct objpool_cache _##NAME##_array_caches[PLAT_CPU_NUM]; \
+    struct objpool NAME = {                                    \
+        .pool = _##NAME##_array,                               \
+        .next = _##NAME##_array_next,                          \
+        .caches = _##NAME##_array_caches,                      \
+        .objsize = sizeof(TYPE),                               \
+        .num = N,                                              \
+        .cache_len = OBJPOOL_CACHE_LEN(N),                     \
+        .lock = SPINLOCK_INITVAL,                              \
     }
 
 void objpool_init(struct objpool* objpool);
 void* objpool_alloc(struct objpool* objpool);
 void objpool_free(struct objpool* objpool, void* obj);
+void objpool_get_stats(struct objpool* objpool, struct objpool_stats* stats);
 
 #endif /* OBJPOOL_H */
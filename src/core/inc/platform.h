@@ -23,6 +23,13 @@ struct platform {
 
     struct {
         paddr_t base;
+        /**
+         * Interrupt raised by the uart when its transmitter can take more data. It is only used
+         * if the hypervisor is built with CONSOLE_IRQ=y, as it is then reserved by the hypervisor
+         * and the console uart can no longer be passed through to a vm. Otherwise, or if left at
+         * zero, the cpus that print to the console wait on the uart for their output.
+         */
+        irqid_t irq_id;
     } console;
 
     struct cache cache;
@@ -10,25 +10,81 @@
 #include <arch/tlb.h>
 
 #include <mem.h>
+#include <fences.h>
+#include <trace.h>
+#include <util.h>
 
 static inline void tlb_inv_va(struct addr_space* as, vaddr_t va)
 {
+    trace_event(TRACE_TLB_INV, (uint32_t)((as->type << 16) | as->id), va);
     if (as->type == AS_HYP) {
-        tlb_hyp_inv_va(va);
+        tlb_hyp_inv_va(mem_as_cpus(as, va), va);
     } else if (as->type == AS_VM) {
-        tlb_vm_inv_va(as->id, va);
+        tlb_vm_inv_va(mem_as_cpus(as, va), as->id, va);
+        // TODO: inval iommu tlbs
+    }
+}
+
+static inline void tlb_inv_range(struct addr_space* as, vaddr_t va, size_t size)
+{
+    trace_event(TRACE_TLB_INV, (uint32_t)((as->type << 16) | as->id), va);
+    if (as->type == AS_HYP) {
+        tlb_hyp_inv_range(mem_as_cpus(as, va), va, size);
+    } else if (as->type == AS_VM) {
+        tlb_vm_inv_range(mem_as_cpus(as, va), as->id, va, size);
         // TODO: inval iommu tlbs
     }
 }
 
 static inline void tlb_inv_all(struct addr_space* as)
 {
+    trace_event(TRACE_TLB_INV, (uint32_t)((as->type << 16) | as->id), ~(uint64_t)0);
     if (as->type == AS_HYP) {
-        tlb_hyp_inv_all();
+        tlb_hyp_inv_all(mem_as_cpus(as, INVALID_VA));
     } else if (as->type == AS_VM) {
-        tlb_vm_inv_all(as->id);
+        tlb_vm_inv_all(mem_as_cpus(as, INVALID_VA), as->id);
         // TODO: inval iommu tlbs
     }
 }
 
+/**
+ * Updates touching several entries of an address space gather the invalidations they need in a
+ * batch, which is only issued by tlb_batch_flush once all entries are written. A batch keeps a
+ * single span covering every queued range, as invalidating unmodified addresses is harmless, and
+ * the arch layer falls back to invalidating the whole address space if the span grows too large.
+ */
+struct tlb_batch {
+    struct addr_space* as;
+    vaddr_t start;
+    vaddr_t end;
+};
+
+static inline void tlb_batch_init(struct tlb_batch* batch, struct addr_space* as)
+{
+    batch->as = as;
+    batch->start = 0;
+    batch->end = 0;
+}
+
+static inline void tlb_batch_add(struct tlb_batch* batch, vaddr_t va, size_t size)
+{
+    if (batch->start == batch->end) {
+        batch->start = va;
+        batch->end = va + size;
+    } else {
+        batch->start = min(batch->start, va);
+        batch->end = max(batch->end, va + size);
+    }
+}
+
+static inline void tlb_batch_flush(struct tlb_batch* batch)
+{
+    if (batch->start != batch->end) {
+        fence_sync_write();
+        tlb_inv_range(batch->as, batch->start, batch->end - batch->start);
+        batch->start = 0;
+        batch->end = 0;
+    }
+}
+
 #endif
@@ -0,0 +1,109 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <bao.h>
+
+/**
+ * Event tracing. When built with TRACE=y, each cpu records timestamped binary events in its own
+ * ring, kept in the shared memory region marked as trace in the configuration. A guest given
+ * access to that shared memory can read the rings at any time, and scripts/trace_decode.py turns a
+ * dump of it into a Chrome trace. Otherwise, all hooks compile to nothing.
+ *
+ * The shared memory starts with a struct trace_hdr, followed by one struct trace_ring per cpu,
+ * each trace_hdr.ring_size bytes long. Only the owner cpu writes to a ring, so no locking is
+ * needed: it fills in the event at head modulo the number of events and only then increments
+ * head. A reader should read head, then the events, and discard those that might have been
+ * overwritten meanwhile according to a second read of head.
+ */
+
+enum trace_event_id {
+    TRACE_VM_EXIT,    /* arg0: arch exit reason (ec or scause), arg1: handling ticks */
+    TRACE_IRQ_INJECT, /* arg0: interrupt id, arg1: vcpu id */
+    TRACE_LR_SPILL,   /* arg0: interrupt id, arg1: list register */
+    TRACE_LR_REFILL,  /* arg0: interrupt id, arg1: list register */
+    TRACE_MSG_SEND,   /* arg0: target cpu, arg1: handler id << 32 | event */
+    TRACE_MSG_RECV,   /* arg0: handler id, arg1: event */
+    TRACE_TLB_INV,    /* arg0: address space type << 16 | id, arg1: address or ~0 for all */
+    TRACE_PAGE_ALLOC, /* arg0: number of pages, arg1: physical base address */
+    TRACE_EVENT_NUM
+};
+
+#define TRACE_MAGIC   (0x43525442) /* "BTRC" */
+#define TRACE_VERSION (1)
+
+struct trace_hdr {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t freq;
+    uint32_t cpu_num;
+    uint32_t ring_size;
+    uint64_t reserved[5];
+};
+
+struct trace_event {
+    uint64_t ts;
+    uint32_t id;
+    uint32_t arg0;
+    uint64_t arg1;
+};
+
+struct trace_ring {
+    volatile uint64_t head;
+    uint64_t reserved[7];
+    struct trace_event events[];
+};
+
+#ifdef TRACE
+
+#include <arch/timestamp.h>
+
+void trace_init(void);
+void trace_event_at(uint64_t ts, enum trace_event_id id, uint32_t arg0, uint64_t arg1);
+
+static inline uint64_t trace_begin(void)
+{
+    return timestamp_get();
+}
+
+static inline void trace_event(enum trace_event_id id, uint32_t arg0, uint64_t arg1)
+{
+    trace_event_at(timestamp_get(), id, arg0, arg1);
+}
+
+/* Records an event starting at begin with the ticks elapsed since then as arg1 */
+static inline void trace_span(enum trace_event_id id, uint64_t begin, uint32_t arg0)
+{
+    trace_event_at(begin, id, arg0, timestamp_get() - begin);
+}
+
+#else
+
+static inline void trace_init(void) { }
+
+static inline uint64_t trace_begin(void)
+{
+    return 0;
+}
+
+static inline void trace_event(enum trace_event_id id, uint32_t arg0, uint64_t arg1)
+{
+    UNUSED_ARG(id);
+    UNUSED_ARG(arg0);
+    UNUSED_ARG(arg1);
+}
+
+static inline void trace_span(enum trace_event_id id, uint64_t begin, uint32_t arg0)
+{
+    UNUSED_ARG(id);
+    UNUSED_ARG(begin);
+    UNUSED_ARG(arg0);
+}
+
+#endif /* TRACE */
+
+#endif /* __TRACE_H__ */
@@ -0,0 +1,75 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __TRAP_STATS_H__
+#define __TRAP_STATS_H__
+
+#include <bao.h>
+
+/**
+ * Trap statistics. When built with TRAP_STATS=y, each vcpu counts the exits to the hypervisor by
+ * reason, together with the time spent handling them and a histogram of the handling times. A
+ * guest can get a snapshot of the statistics for all its vcpus through the HC_TRAP_STATS
+ * hypercall. Otherwise, all hooks compile to nothing and the hypercall is not available.
+ */
+
+enum trap_stat {
+    TRAP_STAT_MEM,    /* memory aborts and guest page faults */
+    TRAP_STAT_SYSREG, /* system register accesses */
+    TRAP_STAT_HVC,    /* hypervisor calls, i.e., hvc or ecall */
+    TRAP_STAT_SMC,    /* secure monitor calls */
+    TRAP_STAT_IRQ,    /* physical interrupts, including the ones below */
+    TRAP_STAT_MAINT,  /* interrupt controller maintenance interrupts */
+    TRAP_STAT_OTHER,
+    TRAP_STAT_NUM
+};
+
+/* Bin i counts the traps that took less than 2^(i+1) ticks, the last one all the others */
+#define TRAP_STATS_HIST_BINS (16)
+
+struct trap_stats {
+    uint64_t count[TRAP_STAT_NUM];
+    uint64_t ticks[TRAP_STAT_NUM];
+    uint32_t hist[TRAP_STAT_NUM][TRAP_STATS_HIST_BINS];
+    /**
+     * Only filled in snapshots: the IPIs raised by the vcpu's physical cpu, whether on behalf of
+     * the vcpu or of the hypervisor, and the ones it avoided as the target already had one pending.
+     */
+    uint64_t ipis_sent;
+    uint64_t ipis_coalesced;
+};
+
+/**
+ * Layout of the snapshot written to the guest buffer. The statistics of the other vcpus are read
+ * while they might be updating them, so they are only approximately consistent with each other.
+ */
+struct trap_stats_snapshot {
+    uint64_t freq;
+    uint64_t vcpu_num;
+    struct trap_stats vcpu[];
+};
+
+#ifdef TRAP_STATS
+
+uint64_t trap_stats_begin(void);
+void trap_stats_end(enum trap_stat stat, uint64_t begin);
+long int trap_stats_hypercall(unsigned long addr, unsigned long size);
+
+#else
+
+static inline uint64_t trap_stats_begin(void)
+{
+    return 0;
+}
+
+static inline void trap_stats_end(enum trap_stat stat, uint64_t begin)
+{
+    UNUSED_ARG(stat);
+    UNUSED_ARG(begin);
+}
+
+#endif /* TRAP_STATS */
+
+#endif /* __TRAP_STATS_H__ */
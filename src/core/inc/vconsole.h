@@ -0,0 +1,57 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __VCONSOLE_H__
+#define __VCONSOLE_H__
+
+#include <bao.h>
+#include <spinlock.h>
+
+/**
+ * Paravirtual console. A vm configured with a vconsole gets a ring at vconsole.base in its address
+ * space, allocated and initialized by the hypervisor. The guest appends output to the ring and
+ * rings the doorbell through the HC_VCONSOLE hypercall whenever it wants it printed, e.g., at the
+ * end of a line or when the ring is filling up. The hypervisor then moves the output to its own
+ * console, one line at a time, tagged with the vm id.
+ *
+ * The guest writes byte i of its output at data[i % size] and, after that, sets head to i + 1.
+ * The hypervisor sets tail to the number of bytes it has consumed, so the guest must not let head
+ * get more than size bytes ahead of tail. Both counters wrap around at 2^32, which is fine as size
+ * is always a power of two. The guest must not write to size or tail.
+ *
+ * Each hypercall consumes at most VCONSOLE_HC_BUDGET bytes, so that a vm cannot hold the cpu, and
+ * the hypervisor console, for long. If tail is still behind head when it returns, the guest must
+ * ring the doorbell again.
+ */
+
+struct vconsole_ring {
+    uint32_t size;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    uint32_t reserved;
+    char data[];
+};
+
+/* Longer lines are split */
+#define VCONSOLE_LINE_LEN  (128)
+
+#define VCONSOLE_HC_BUDGET (512)
+
+struct vconsole {
+    spinlock_t lock;
+    struct vconsole_ring* ring;
+    uint32_t size;
+    uint32_t tail;
+    size_t line_len;
+    char line[VCONSOLE_LINE_LEN];
+};
+
+struct vm;
+struct vm_config;
+
+void vconsole_init(struct vm* vm, const struct vm_config* vm_config);
+long int vconsole_hypercall(void);
+
+#endif /* __VCONSOLE_H__ */
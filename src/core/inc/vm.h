@@ -13,10 +13,13 @@
 #include <cpu.h>
 #include <spinlock.h>
 #include <emul.h>
+#include <trap_stats.h>
+#include <memguard.h>
 #include <interrupts.h>
 #include <bitmap.h>
 #include <io.h>
 #include <ipc.h>
+#include <vconsole.h>
 
 struct vm_mem_region {
     paddr_t base;
@@ -24,8 +27,19 @@ struct vm_mem_region {
     colormap_t colors;
     bool place_phys;
     paddr_t phys;
+    /**
+     * Do not map the region at boot. Instead, populate it on demand as the guest first touches it.
+     * Ignored for regions placed at a fixed physical address or holding the guest image.
+     */
+    bool lazy;
 };
 
+#define VM_EMUL_MEM_MAX (8)
+#define VM_EMUL_REG_MAX (8)
+
+/* Size of the batch of pages populated around each fault on a lazy region */
+#define VM_MEM_LAZY_BATCH (16UL * PAGE_SIZE)
+
 struct vm_dev_region {
     paddr_t pa;
     vaddr_t va;
@@ -47,6 +61,15 @@ struct vm_platform {
     size_t dev_num;
     struct vm_dev_region* devs;
 
+    /**
+     * Paravirtual console ring, mapped at base in the vm's address space. There is none if size
+     * is zero. See vconsole.h.
+     */
+    struct {
+        vaddr_t base;
+        size_t size;
+    } vconsole;
+
     // /**
     //  * In MPU-based platforms which might also support virtual memory
     //  * (i.e. aarch64 cortex-r) the hypervisor sets up the VM using an MPU by
@@ -75,8 +98,11 @@ struct vm {
 
     struct vm_arch arch;
 
-    struct list emul_mem_list;
-    struct list emul_reg_list;
+    /* Emulation handlers, sorted by address */
+    struct emul_mem* emul_mem[VM_EMUL_MEM_MAX];
+    size_t emul_mem_num;
+    struct emul_reg* emul_reg[VM_EMUL_REG_MAX];
+    size_t emul_reg_num;
 
     struct vm_io io;
 
@@ -84,6 +110,18 @@ struct vm {
 
     size_t ipc_num;
     struct ipc* ipcs;
+
+    struct vconsole vconsole;
+
+    /* Set once the vm's pages start being moved to new colors, see vm_recolor_hypercall */
+    volatile bool recolored;
+
+    /* Image copy set up by the master and carried out by all the vm's cpus */
+    struct {
+        vaddr_t src;
+        vaddr_t dst;
+        size_t size;
+    } install;
 };
 
 struct vcpu {
@@ -97,6 +135,18 @@ struct vcpu {
     bool active;
 
     struct vm* vm;
+
+    /* Last emulation handlers hit by this vcpu, checked before searching the vm's handlers */
+    struct emul_mem* emul_mem_last;
+    struct emul_reg* emul_reg_last;
+
+#ifdef TRAP_STATS
+    struct trap_stats stats;
+#endif
+
+#ifdef MEMGUARD
+    struct memguard_stats memguard;
+#endif
 };
 
 struct vm_allocation {
@@ -113,6 +163,7 @@ void vm_emul_add_mem(struct vm* vm, struct emul_mem* emu);
 void vm_emul_add_reg(struct vm* vm, struct emul_reg* emu);
 emul_handler_t vm_emul_get_mem(struct vm* vm, vaddr_t addr);
 emul_handler_t vm_emul_get_reg(struct vm* vm, vaddr_t addr);
+bool vm_mem_fault(struct vm* vm, vaddr_t addr);
 void vcpu_init(struct vcpu* vcpu, struct vm* vm, vaddr_t entry);
 void vm_msg_broadcast(struct vm* vm, struct cpu_msg* msg);
 cpumap_t vm_translate_to_pcpu_mask(struct vm* vm, cpumap_t mask, size_t len);
@@ -164,6 +215,9 @@ static inline void vcpu_inject_irq(struct vcpu* vcpu, irqid_t id)
 /* ------------------------------------------------------------*/
 
 void vm_mem_prot_init(struct vm* vm, const struct vm_config* config);
+#ifdef MEM_PROT_MMU
+long int vm_recolor_hypercall(unsigned long vm_id, unsigned long colors, unsigned long budget);
+#endif
 
 /* ------------------------------------------------------------*/
 
@@ -12,6 +12,7 @@
 #include <printk.h>
 #include <platform.h>
 #include <vmm.h>
+#include <boot_prof.h>
 
 void init(cpuid_t cpu_id, paddr_t load_addr)
 {
@@ -20,7 +21,10 @@ void init(cpuid_t cpu_id, paddr_t load_addr)
      */
 
     cpu_init(cpu_id, load_addr);
+    uint64_t entry = boot_prof_begin();
     mem_init(load_addr);
+    boot_prof_start(entry);
+    boot_prof_end(BOOT_PROF_MEM_INIT, entry);
 
     /* -------------------------------------------------------------- */
 
@@ -32,6 +36,8 @@ void init(cpuid_t cpu_id, paddr_t load_addr)
 
     interrupts_init();
 
+    console_irq_init();
+
     vmm_init();
 
     /* Should never reach here */
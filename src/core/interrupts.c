@@ -9,6 +9,7 @@
 #include <vm.h>
 #include <bitmap.h>
 #include <string.h>
+#include <trace.h>
 
 BITMAP_ALLOC(global_interrupt_bitmap, MAX_INTERRUPT_LINES);
 spinlock_t irq_reserve_lock = SPINLOCK_INITVAL;
@@ -73,19 +74,27 @@ static inline bool interrupt_assigned(irqid_t int_id)
 
 enum irq_res interrupts_handle(irqid_t int_id)
 {
+    enum irq_res res = HANDLED_BY_HYP;
+    uint64_t trap_begin = trap_stats_begin();
+
     if (vm_has_interrupt(cpu()->vcpu->vm, int_id)) {
         vcpu_inject_hw_irq(cpu()->vcpu, int_id);
+        trace_event(TRACE_IRQ_INJECT, (uint32_t)int_id, cpu()->vcpu->id);
 
-        return FORWARD_TO_VM;
+        res = FORWARD_TO_VM;
 
     } else if (interrupt_assigned_to_hyp(int_id)) {
         interrupt_handlers[int_id](int_id);
 
-        return HANDLED_BY_HYP;
+        res = HANDLED_BY_HYP;
 
     } else {
         ERROR("received unknown interrupt id = %d", int_id);
     }
+
+    trap_stats_end(TRAP_STAT_IRQ, trap_begin);
+
+    return res;
 }
 
 bool interrupts_vm_assign(struct vm* vm, irqid_t id)
@@ -10,6 +10,7 @@
 #include <hypercall.h>
 #include <config.h>
 #include <shmem.h>
+#include <platform.h>
 
 enum { IPC_NOTIFY };
 
@@ -80,9 +81,10 @@ long int ipc_hypercall(unsigned long ipc_id, unsigned long ipc_event, unsigned l
         };
         struct cpu_msg msg = { (uint32_t)IPC_CPUMSG_ID, IPC_NOTIFY, data.raw };
 
-        for (size_t i = 0; i < platform.cpu_num; i++) {
-            if (ipc_cpu_masters & (1ULL << i)) {
-                cpu_send_msg(i, &msg);
+        /* Let the guest know if any target is too busy to take the notification, so it can retry */
+        for (cpuid_t i = 0; i < platform.cpu_num; i++) {
+            if ((ipc_cpu_masters & (1UL << i)) && !cpu_try_send_msg(i, &msg)) {
+                ret = -HC_E_FAILURE;
             }
         }
 
@@ -13,6 +13,7 @@
 #include <vm.h>
 #include <fences.h>
 #include <config.h>
+#include <trace.h>
 
 extern uint8_t _image_start, _image_load_end, _image_end, _vm_image_start, _vm_image_end;
 
@@ -31,6 +32,19 @@ bool pp_alloc(struct page_pool* pool, size_t num_pages, bool aligned, struct ppa
 
     spin_lock(&pool->lock);
 
+#ifdef PP_BUDDY
+    size_t index;
+    if (pp_buddy_alloc(pool, num_pages, aligned, &index)) {
+        ppages->base = pool->base + (index * PAGE_SIZE);
+        ppages->num_pages = num_pages;
+        bitmap_set_consecutive(pool->bitmap, index, num_pages);
+        pp_clr_mark(pool, index, num_pages, true);
+        pool->free -= num_pages;
+        spin_unlock(&pool->lock);
+        return true;
+    }
+#endif
+
     /**
      * If we need a contigous segment aligned to its size, lets start at an already aligned index.
      */
@@ -69,7 +83,7 @@ bool pp_alloc(struct page_pool* pool, size_t num_pages, bool aligned, struct ppa
                  */
                 ppages->base = pool->base + (((size_t)bit) * PAGE_SIZE);
                 ppages->num_pages = num_pages;
-                bitmap_set_consecutive(pool->bitmap, ((size_t)bit), num_pages);
+                pp_mark_alloced(pool, ((size_t)bit), num_pages);
                 pool->free -= num_pages;
                 pool->last = ((size_t)bit) + num_pages;
                 ok = true;
@@ -118,7 +132,7 @@ static bool mem_reserve_ppool_ppages(struct page_pool* pool, struct ppages* ppag
         was_free = false;
     }
 
-    bitmap_set_consecutive(pool->bitmap, pageoff, ppages->num_pages);
+    pp_mark_alloced(pool, pageoff, ppages->num_pages);
     pool->free -= ppages->num_pages;
 
     return is_in_rgn && was_free;
@@ -136,14 +150,43 @@ void* mem_alloc_page(size_t num_pages, enum AS_SEC sec, bool phys_aligned)
     return (void*)vpage;
 }
 
+static inline size_t pp_page_bitmap_size(struct page_pool* pool)
+{
+    return pool->size / (8 * PAGE_SIZE) + ((pool->size % (8 * PAGE_SIZE) != 0) ? 1 : 0);
+}
+
+/**
+ * Returns the number of pages needed for the pool's bookkeeping, i.e., the page bitmap, followed by
+ * the per-color bitmaps and the buddy allocator maps when it is enabled.
+ */
+size_t pp_bitmap_size(struct page_pool* pool)
+{
+    size_t maps_size = pp_clr_size(pool);
+#ifdef PP_BUDDY
+    maps_size += pp_buddy_size(pool);
+#endif
+    return pp_page_bitmap_size(pool) + NUM_PAGES(maps_size);
+}
+
+static void pp_init_bitmap(struct page_pool* pool, bitmap_t* bitmap, size_t num_pages)
+{
+    vaddr_t maps = (vaddr_t)bitmap + (pp_page_bitmap_size(pool) * PAGE_SIZE);
+
+    pool->bitmap = bitmap;
+    memset((void*)pool->bitmap, 0, num_pages * PAGE_SIZE);
+    pp_clr_init(pool, (void*)maps);
+#ifdef PP_BUDDY
+    pp_buddy_init(pool, (void*)(maps + pp_clr_size(pool)));
+#endif
+}
+
 static bool root_pool_set_up_bitmap(paddr_t load_addr, struct page_pool* root_pool)
 {
     size_t image_size = (size_t)(&_image_end - &_image_start);
     size_t vm_image_size = (size_t)(&_vm_image_end - &_vm_image_start);
     size_t cpu_size = platform.cpu_num * mem_cpu_boot_alloc_size();
 
-    size_t bitmap_num_pages =
-        root_pool->size / (8 * PAGE_SIZE) + ((root_pool->size % (8 * PAGE_SIZE) != 0) ? 1 : 0);
+    size_t bitmap_num_pages = pp_bitmap_size(root_pool);
     if (root_pool->size <= bitmap_num_pages) {
         return false;
     }
@@ -152,8 +195,7 @@ static bool root_pool_set_up_bitmap(paddr_t load_addr, struct page_pool* root_po
     struct ppages bitmap_pp = mem_ppages_get(bitmap_base, bitmap_num_pages);
     bitmap_t* root_bitmap = (bitmap_t*)mem_alloc_map(&cpu()->as, SEC_HYP_GLOBAL, &bitmap_pp,
         INVALID_VA, bitmap_num_pages, PTE_HYP_FLAGS);
-    root_pool->bitmap = root_bitmap;
-    memset((void*)root_pool->bitmap, 0, bitmap_num_pages * PAGE_SIZE);
+    pp_init_bitmap(root_pool, root_bitmap, bitmap_num_pages);
 
     return mem_reserve_ppool_ppages(root_pool, &bitmap_pp);
 }
@@ -209,7 +251,7 @@ static void pp_init(struct page_pool* pool, paddr_t base, size_t size)
     memset((void*)pool, 0, sizeof(struct page_pool));
     pool->base = ALIGN(base, PAGE_SIZE);
     pool->size = NUM_PAGES(size);
-    size_t bitmap_size = pool->size / (8 * PAGE_SIZE) + !!(pool->size % (8 * PAGE_SIZE) != 0);
+    size_t bitmap_size = pp_bitmap_size(pool);
 
     if (size <= bitmap_size) {
         return;
@@ -220,12 +262,13 @@ static void pp_init(struct page_pool* pool, paddr_t base, size_t size)
         return;
     }
 
-    if ((pool->bitmap = (bitmap_t*)mem_alloc_map(&cpu()->as, SEC_HYP_GLOBAL, &pages, INVALID_VA,
-             bitmap_size, PTE_HYP_FLAGS)) == NULL) {
+    bitmap_t* bitmap = (bitmap_t*)mem_alloc_map(&cpu()->as, SEC_HYP_GLOBAL, &pages, INVALID_VA,
+        bitmap_size, PTE_HYP_FLAGS);
+    if (bitmap == NULL) {
         return;
     }
 
-    memset((void*)pool->bitmap, 0, bitmap_size * PAGE_SIZE);
+    pp_init_bitmap(pool, bitmap, bitmap_size);
 
     pool->last = 0;
     pool->free = pool->size;
@@ -251,6 +294,23 @@ static bool mem_vm_img_in_phys_rgn(struct vm_config* vm_config)
     return img_in_rgn;
 }
 
+static bool mem_vm_img_reserved(size_t vm_id)
+{
+    /**
+     * VMs sharing an image map the same pages, so they are only reserved once. Colored VMs do not
+     * share, as recoloring the image in place frees the pages outside their colors.
+     */
+    struct vm_config* vm_cfg = &config.vmlist[vm_id];
+    for (size_t i = 0; (i < vm_id) && config_vm_img_shared(vm_cfg); i++) {
+        struct vm_config* other = &config.vmlist[i];
+        if (config_vm_img_shared(other) && (other->image.load_addr == vm_cfg->image.load_addr) &&
+            (other->image.size == vm_cfg->image.size)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 static bool mem_reserve_physical_memory(struct page_pool* pool)
 {
     if (pool == NULL) {
@@ -267,7 +327,7 @@ static bool mem_reserve_physical_memory(struct page_pool* pool)
         // not allow partial overlaps. If the image must be entirely inside a statically allocated
         // region, or completely outside of it. This avoid overcamplicating the reservation logic
         // while still covering all the useful use cases.
-        if (mem_vm_img_in_phys_rgn(vm_cfg)) {
+        if (mem_vm_img_in_phys_rgn(vm_cfg) || mem_vm_img_reserved(i)) {
             continue;
         }
 
@@ -376,6 +436,29 @@ __attribute__((weak)) bool mem_map_reclr(struct addr_space* as, vaddr_t va, stru
     ERROR("Trying to recolor section but there is no coloring implementation");
 }
 
+__attribute__((weak)) size_t pp_clr_size(struct page_pool* pool)
+{
+    UNUSED_ARG(pool);
+
+    return 0;
+}
+
+__attribute__((weak)) void pp_clr_init(struct page_pool* pool, void* maps)
+{
+    UNUSED_ARG(maps);
+
+    pool->clr_bitmap = NULL;
+}
+
+__attribute__((weak)) void pp_clr_mark(struct page_pool* pool, size_t index, size_t num_pages,
+    bool alloced)
+{
+    UNUSED_ARG(pool);
+    UNUSED_ARG(index);
+    UNUSED_ARG(num_pages);
+    UNUSED_ARG(alloced);
+}
+
 __attribute__((weak)) bool pp_alloc_clr(struct page_pool* pool, size_t num_pages, colormap_t colors,
     struct ppages* ppages)
 {
@@ -400,6 +483,10 @@ struct ppages mem_alloc_ppages(colormap_t colors, size_t num_pages, bool aligned
         }
     }
 
+    if (pages.num_pages > 0) {
+        trace_event(TRACE_PAGE_ALLOC, (uint32_t)pages.num_pages, pages.base);
+    }
+
     return pages;
 }
 
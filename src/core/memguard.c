@@ -0,0 +1,153 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <memguard.h>
+#include <arch/memguard.h>
+#include <arch/timestamp.h>
+
+#include <cpu.h>
+#include <vm.h>
+#include <config.h>
+#include <interrupts.h>
+#include <hypercall.h>
+
+static struct memguard {
+    uint32_t budget;
+    uint64_t period;
+    uint64_t next;
+    bool throttled;
+} memguard[PLAT_CPU_NUM];
+
+static irqid_t memguard_pmu_irq_id = INVALID_IRQID;
+static irqid_t memguard_timer_irq_id = INVALID_IRQID;
+
+static void memguard_replenish(struct memguard* mg, uint64_t now)
+{
+    mg->next += mg->period;
+    if (mg->next <= now) {
+        mg->next = now + mg->period;
+    }
+    memguard_arch_timer_set(mg->next);
+    memguard_arch_pmu_set(mg->budget);
+}
+
+static void memguard_pmu_handler(irqid_t int_id)
+{
+    UNUSED_ARG(int_id);
+
+    /* The vcpu is only throttled after the interrupt is completed, in memguard_irq_exit */
+    memguard_arch_pmu_ack();
+    memguard[cpu()->id].throttled = true;
+}
+
+static void memguard_timer_handler(irqid_t int_id)
+{
+    UNUSED_ARG(int_id);
+
+    memguard_replenish(&memguard[cpu()->id], timestamp_get());
+}
+
+void memguard_init(void)
+{
+    if (cpu_is_master()) {
+        bool regulated = false;
+        for (size_t i = 0; i < config.vmlist_size; i++) {
+            regulated = regulated || (config.vmlist[i].memguard.budget != 0);
+        }
+
+        if (regulated) {
+            memguard_pmu_irq_id = interrupts_reserve(MEMGUARD_ARCH_PMU_IRQ, memguard_pmu_handler);
+            memguard_timer_irq_id =
+                interrupts_reserve(MEMGUARD_ARCH_TIMER_IRQ, memguard_timer_handler);
+            if ((memguard_pmu_irq_id == INVALID_IRQID) ||
+                (memguard_timer_irq_id == INVALID_IRQID)) {
+                ERROR("failed to reserve memguard interrupts");
+            }
+        }
+    }
+}
+
+void memguard_cpu_init(const struct vm_config* vm_config)
+{
+    struct memguard* mg = &memguard[cpu()->id];
+    uint64_t period = (timestamp_freq() * vm_config->memguard.period_us) / 1000000;
+
+    if (vm_config->memguard.budget == 0) {
+        return;
+    } else if (period == 0) {
+        WARNING("cpu%d memguard period too short, not regulated", cpu()->id);
+        return;
+    } else if (!memguard_arch_init()) {
+        WARNING("cpu%d has no pmu counter left for memguard, not regulated", cpu()->id);
+        return;
+    }
+
+    mg->budget = vm_config->memguard.budget;
+    mg->period = period;
+    mg->next = timestamp_get();
+    mg->throttled = false;
+    memguard_replenish(mg, mg->next);
+
+    interrupts_cpu_enable(memguard_pmu_irq_id, true);
+    interrupts_cpu_enable(memguard_timer_irq_id, true);
+}
+
+/**
+ * Called on the way back to the guest after each interrupt. The cpu cannot simply go to cpu_idle,
+ * as on some platforms that powers it down, losing the pmu and timer state. It waits for the end of
+ * the period instead, still serving messages from other cpus. Interrupts for the guest are left
+ * pending until it runs again.
+ */
+void memguard_irq_exit(void)
+{
+    struct memguard* mg = &memguard[cpu()->id];
+
+    if (!mg->throttled) {
+        return;
+    }
+
+    uint64_t begin = timestamp_get();
+    uint64_t now = begin;
+    while (now < mg->next) {
+        if (interrupts_check(interrupts_ipi_id)) {
+            interrupts_clear(interrupts_ipi_id);
+            cpu_msg_handler();
+        }
+        memguard_arch_wait();
+        now = timestamp_get();
+    }
+
+    mg->throttled = false;
+    memguard_replenish(mg, now);
+
+    struct memguard_stats* stats = &cpu()->vcpu->memguard;
+    stats->count += 1;
+    stats->ticks += now - begin;
+}
+
+long int memguard_hypercall(unsigned long vcpu_id, unsigned long stat)
+{
+    struct vm* vm = cpu()->vcpu->vm;
+
+    if (vcpu_id >= vm->cpu_num) {
+        return -HC_E_INVAL_ARGS;
+    }
+
+    long int ret;
+    struct memguard_stats* stats = &vm_get_vcpu(vm, (vcpuid_t)vcpu_id)->memguard;
+    switch (stat) {
+        case MEMGUARD_STAT_COUNT:
+            ret = (long int)stats->count;
+            break;
+        case MEMGUARD_STAT_TICKS:
+            ret = (long int)stats->ticks;
+            break;
+        default:
+            ret = -HC_E_INVAL_ARGS;
+            break;
+    }
+
+    return ret;
+}
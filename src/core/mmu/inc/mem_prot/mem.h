@@ -24,5 +24,15 @@ typedef pte_t mem_flags_t;
 
 void as_init(struct addr_space* as, enum AS_TYPE type, asid_t id, pte_t* root_pt, colormap_t colors);
 vaddr_t mem_alloc_vpage(struct addr_space* as, enum AS_SEC section, vaddr_t at, size_t n);
+/**
+ * Returns the cpus which might have cached translations for va in as, i.e., the ones a tlb
+ * invalidation must reach. If va is INVALID_VA, the whole address space is considered.
+ */
+cpumap_t mem_as_cpus(struct addr_space* as, vaddr_t va);
+/**
+ * Moves the page mapped at va, if any, to a page of the given colors unless it already has one of
+ * them or is read-only. Returns false if no page of those colors could be allocated.
+ */
+bool mem_recolor_page(struct addr_space* as, vaddr_t va, colormap_t colors);
 
 #endif /* __MEM_PROT_H__ */
@@ -74,6 +74,217 @@ static inline size_t pp_next_clr(paddr_t base, size_t from, colormap_t colors)
     return index;
 }
 
+/**
+ * Per-color page bookkeeping. Physical pages repeat the color pattern every COLOR_NUM * COLOR_SIZE
+ * pages (a color period), each color taking COLOR_SIZE consecutive pages of it. A pool keeps one
+ * bitmap per color indexed by the page's rank within that color, so finding free pages of a color
+ * scans 32 of them per bitmap granule, regardless of how many colors there are.
+ *
+ * A colored run is a sequence of pages that walks only over the pages of a given colormap, which is
+ * what a colored struct ppages describes. Positions along the run's colors are counted from the
+ * color period the pool starts in. Each color's share of a run is a contiguous range of its
+ * bitmap, so runs are checked and updated one color at a time instead of one page at a time.
+ */
+
+static inline size_t pp_clr_period(void)
+{
+    return COLOR_NUM * COLOR_SIZE;
+}
+
+static inline size_t pp_clr_first_period(struct page_pool* pool)
+{
+    return (pool->base / PAGE_SIZE) / pp_clr_period();
+}
+
+static inline size_t pp_clr_len(struct page_pool* pool)
+{
+    size_t last_period = ((pool->base / PAGE_SIZE) + pool->size - 1) / pp_clr_period();
+    return (last_period - pp_clr_first_period(pool) + 1) * COLOR_SIZE;
+}
+
+static inline bitmap_t* pp_clr_map(struct page_pool* pool, size_t color)
+{
+    return pool->clr_bitmap + (color * BITMAP_SIZE(pool->clr_len));
+}
+
+/**
+ * Returns the number of pages of the given color below pool page index.
+ */
+static size_t pp_clr_count(struct page_pool* pool, size_t color, size_t index)
+{
+    size_t pfn = (pool->base / PAGE_SIZE) + index;
+    size_t period_off = pfn % pp_clr_period();
+    size_t color_off = color * COLOR_SIZE;
+    size_t partial = (period_off > color_off) ? min(period_off - color_off, COLOR_SIZE) : 0;
+    return (((pfn / pp_clr_period()) - pp_clr_first_period(pool)) * COLOR_SIZE) + partial;
+}
+
+/**
+ * Returns the pool page index of the j-th page of a color.
+ */
+static inline size_t pp_clr_page(struct page_pool* pool, size_t color, size_t j)
+{
+    size_t pfn = ((pp_clr_first_period(pool) + (j / COLOR_SIZE)) * pp_clr_period()) +
+        (color * COLOR_SIZE) + (j % COLOR_SIZE);
+    return pfn - (pool->base / PAGE_SIZE);
+}
+
+struct pp_clr_run {
+    colormap_t colors;
+    size_t period_pages;
+    uint8_t rank[PP_CLR_MAX];
+    uint8_t color[PP_CLR_MAX];
+};
+
+static void pp_clr_run_init(struct pp_clr_run* run, colormap_t colors)
+{
+    run->colors = colors & BIT_MASK(0, COLOR_NUM);
+    run->period_pages = 0;
+    for (size_t c = 0, r = 0; c < COLOR_NUM; c++) {
+        if (bit_get(run->colors, c)) {
+            run->rank[c] = (uint8_t)r;
+            run->color[r] = (uint8_t)c;
+            run->period_pages += COLOR_SIZE;
+            r++;
+        }
+    }
+}
+
+/**
+ * Returns the rank, within the color's bitmap, of the first page of the color at or after position
+ * pos of the run.
+ */
+static inline size_t pp_clr_run_rank(struct pp_clr_run* run, size_t color, size_t pos)
+{
+    size_t color_off = run->rank[color] * COLOR_SIZE;
+    size_t period_off = pos % run->period_pages;
+    size_t partial = (period_off > color_off) ? min(period_off - color_off, COLOR_SIZE) : 0;
+    return ((pos / run->period_pages) * COLOR_SIZE) + partial;
+}
+
+static inline size_t pp_clr_run_pos(struct pp_clr_run* run, size_t color, size_t j)
+{
+    return ((j / COLOR_SIZE) * run->period_pages) + (run->rank[color] * COLOR_SIZE) +
+        (j % COLOR_SIZE);
+}
+
+/**
+ * Returns the position along the run of the first page of the run's colors at or after index.
+ */
+static size_t pp_clr_run_pos_of(struct page_pool* pool, struct pp_clr_run* run, size_t index)
+{
+    size_t pos = 0;
+    for (size_t r = 0; r < (run->period_pages / COLOR_SIZE); r++) {
+        pos += pp_clr_count(pool, run->color[r], index);
+    }
+    return pos;
+}
+
+static inline size_t pp_clr_run_index(struct page_pool* pool, struct pp_clr_run* run, size_t pos)
+{
+    size_t color = run->color[(pos % run->period_pages) / COLOR_SIZE];
+    return pp_clr_page(pool, color, pp_clr_run_rank(run, color, pos));
+}
+
+/**
+ * Returns the position of the first free page of the run's colors at or after pos, or -1 if there
+ * is none. Searches starting below a color's hint start at the hint and move it forward.
+ */
+static ssize_t pp_clr_run_next_free(struct page_pool* pool, struct pp_clr_run* run, size_t pos)
+{
+    ssize_t next = -1;
+
+    for (size_t r = 0; r < (run->period_pages / COLOR_SIZE); r++) {
+        size_t color = run->color[r];
+        size_t j = pp_clr_run_rank(run, color, pos);
+        bool from_hint = (j <= pool->clr_hint[color]);
+        j = from_hint ? pool->clr_hint[color] : j;
+
+        ssize_t bit = bitmap_find_next_clear(pp_clr_map(pool, color), pool->clr_len, j);
+        if (from_hint) {
+            pool->clr_hint[color] = (bit < 0) ? pool->clr_len : (size_t)bit;
+        }
+        if (bit >= 0) {
+            ssize_t bit_pos = (ssize_t)pp_clr_run_pos(run, color, (size_t)bit);
+            next = ((next < 0) || (bit_pos < next)) ? bit_pos : next;
+        }
+    }
+
+    return next;
+}
+
+static void pp_clr_run_mark(struct page_pool* pool, struct pp_clr_run* run, size_t pos, size_t n,
+    bool alloced)
+{
+    for (size_t r = 0; r < (run->period_pages / COLOR_SIZE); r++) {
+        size_t color = run->color[r];
+        size_t start = pp_clr_run_rank(run, color, pos);
+        size_t end = pp_clr_run_rank(run, color, pos + n);
+        bitmap_t* map = pp_clr_map(pool, color);
+
+        if (alloced) {
+            bitmap_set_consecutive(map, start, end - start);
+        } else {
+            bitmap_clear_consecutive(map, start, end - start);
+            pool->clr_hint[color] = min(pool->clr_hint[color], start);
+        }
+
+        /* Pages of the same color are contiguous within each color period */
+        for (size_t j = start; j < end;) {
+            size_t len = min(COLOR_SIZE - (j % COLOR_SIZE), end - j);
+            pp_mark_pages(pool, pp_clr_page(pool, color, j), len, alloced);
+            j += len;
+        }
+    }
+}
+
+size_t pp_clr_size(struct page_pool* pool)
+{
+    if ((COLOR_NUM <= 1) || (pool->size == 0)) {
+        return 0;
+    }
+
+    return COLOR_NUM * BITMAP_SIZE(pp_clr_len(pool)) * sizeof(bitmap_granule_t);
+}
+
+void pp_clr_init(struct page_pool* pool, void* maps)
+{
+    if ((COLOR_NUM <= 1) || (pool->size == 0)) {
+        pool->clr_bitmap = NULL;
+        return;
+    }
+
+    pool->clr_bitmap = (bitmap_t*)maps;
+    pool->clr_len = pp_clr_len(pool);
+
+    /* Pages of the first and last color periods which are outside the pool are never free */
+    for (size_t color = 0; color < COLOR_NUM; color++) {
+        size_t start = pp_clr_count(pool, color, 0);
+        size_t end = pp_clr_count(pool, color, pool->size);
+        bitmap_set_consecutive(pp_clr_map(pool, color), 0, pool->clr_len);
+        bitmap_clear_consecutive(pp_clr_map(pool, color), start, end - start);
+        pool->clr_hint[color] = start;
+    }
+}
+
+void pp_clr_mark(struct page_pool* pool, size_t index, size_t num_pages, bool alloced)
+{
+    if (pool->clr_bitmap == NULL) {
+        return;
+    }
+
+    for (size_t color = 0; color < COLOR_NUM; color++) {
+        size_t start = pp_clr_count(pool, color, index);
+        size_t end = pp_clr_count(pool, color, index + num_pages);
+        if (alloced) {
+            bitmap_set_consecutive(pp_clr_map(pool, color), start, end - start);
+        } else {
+            bitmap_clear_consecutive(pp_clr_map(pool, color), start, end - start);
+            pool->clr_hint[color] = min(pool->clr_hint[color], start);
+        }
+    }
+}
+
 static void mem_free_ppages(struct ppages* ppages)
 {
     list_foreach (page_pool_list, struct page_pool, pool) {
@@ -81,12 +292,12 @@ static void mem_free_ppages(struct ppages* ppages)
         if (in_range(ppages->base, pool->base, pool->size * PAGE_SIZE)) {
             size_t index = (ppages->base - pool->base) / PAGE_SIZE;
             if (!all_clrs(ppages->colors)) {
-                for (size_t i = 0; i < ppages->num_pages; i++) {
-                    index = pp_next_clr(pool->base, index, ppages->colors);
-                    bitmap_clear(pool->bitmap, index++);
-                }
+                struct pp_clr_run run;
+                pp_clr_run_init(&run, ppages->colors);
+                size_t pos = pp_clr_run_pos_of(pool, &run, index);
+                pp_clr_run_mark(pool, &run, pos, ppages->num_pages, false);
             } else {
-                bitmap_clear_consecutive(pool->bitmap, index, ppages->num_pages);
+                pp_mark_free(pool, index, ppages->num_pages);
             }
         }
         spin_unlock(&pool->lock);
@@ -95,71 +306,62 @@ static void mem_free_ppages(struct ppages* ppages)
 
 bool pp_alloc_clr(struct page_pool* pool, size_t n, colormap_t colors, struct ppages* ppages)
 {
-    size_t allocated = 0;
-
-    size_t first_index = 0;
+    struct pp_clr_run run;
     bool ok = false;
 
     ppages->colors = colors;
     ppages->num_pages = 0;
 
-    spin_lock(&pool->lock);
+    if (pool->clr_bitmap == NULL) {
+        return false;
+    }
 
-    /**
-     * Lets start the search at the first available color after the last known free position to the
-     * top of the pool.
-     */
-    size_t index = pp_next_clr(pool->base, pool->last, colors);
-    size_t top = pool->size;
+    pp_clr_run_init(&run, colors);
+
+    spin_lock(&pool->lock);
 
     /**
-     * Two iterations. One starting from the last known free page, other starting from the
-     * beggining of page pool to the start of the previous iteration.
+     * Start at the first free page of the target colors. For each candidate position, check if
+     * each color's share of the run is free. If not, resume the search at the first free page after
+     * the first allocated one, so that each iteration skips at least one allocated range.
      */
-    for (size_t i = 0; i < 2 && !ok; i++) {
-        while ((allocated < n) && (index < top)) {
-            allocated = 0;
-
-            /* Find first free page on the target colors */
-            while ((index < top) && bitmap_get(pool->bitmap, index)) {
-                index = pp_next_clr(pool->base, ++index, colors);
+    ssize_t pos = pp_clr_run_next_free(pool, &run, 0);
+    while (pos >= 0) {
+        ssize_t blocked = -1;
+        bool fits = true;
+
+        for (size_t r = 0; r < (run.period_pages / COLOR_SIZE); r++) {
+            size_t color = run.color[r];
+            size_t start = pp_clr_run_rank(&run, color, (size_t)pos);
+            size_t end = pp_clr_run_rank(&run, color, (size_t)pos + n);
+            if (end > pool->clr_len) {
+                fits = false;
+                break;
             }
-            first_index = index;
 
-            /**
-             * Count the number of free pages contigous on the target color segement until n pages
-             * are found or we reach top page of the search.
-             */
-            while ((index < top) && (bitmap_get(pool->bitmap, index) == 0) && (allocated < n)) {
-                allocated++;
-                index = pp_next_clr(pool->base, ++index, colors);
+            ssize_t bit = bitmap_find_next_set(pp_clr_map(pool, color), end, start);
+            if (bit >= 0) {
+                ssize_t bit_pos = (ssize_t)pp_clr_run_pos(&run, color, (size_t)bit);
+                blocked = ((blocked < 0) || (bit_pos < blocked)) ? bit_pos : blocked;
             }
-
-            index++;
         }
 
-        if (allocated == n) {
+        if (!fits) {
+            break;
+        } else if (blocked < 0) {
             /**
-             * We've found n contigous free pages that fit the color pattern, Fill the output ppage
-             * arg, mark the pages as allocated and update page pool internal state.
+             * We've found n free pages that fit the color pattern, Fill the output ppage arg, mark
+             * the pages as allocated and update page pool internal state.
              */
             ppages->num_pages = n;
-            ppages->base = pool->base + (first_index * PAGE_SIZE);
-            for (size_t j = 0; j < n; j++) {
-                first_index = pp_next_clr(pool->base, first_index, colors);
-                bitmap_set(pool->bitmap, first_index++);
-            }
+            ppages->base = pool->base + (pp_clr_run_index(pool, &run, (size_t)pos) * PAGE_SIZE);
+            pp_clr_run_mark(pool, &run, (size_t)pos, n, true);
             pool->free -= n;
-            pool->last = first_index;
             ok = true;
             break;
-        } else {
-            /**
-             * If this is the first iteration, setup index and top to search from base of the page
-             * pool until the previous iteration start point
-             */
-            index = 0;
         }
+
+        pos = pp_clr_run_next_free(pool, &run, (size_t)blocked + 1);
     }
 
     spin_unlock(&pool->lock);
@@ -178,6 +380,25 @@ static struct section* mem_find_sec(struct addr_space* as, vaddr_t va)
     return NULL;
 }
 
+cpumap_t mem_as_cpus(struct addr_space* as, vaddr_t va)
+{
+    cpumap_t cpus = BIT_MASK(0, platform.cpu_num);
+
+    if (as->type == AS_VM) {
+        /**
+         * The vm cpus are only reachable through the current vcpu. If there is none yet, or it
+         * belongs to another vm, all cpus are targeted.
+         */
+        if ((cpu()->vcpu != NULL) && (cpu()->vcpu->vm->id == as->id)) {
+            cpus = cpu()->vcpu->vm->cpus;
+        }
+    } else if ((va != INVALID_VA) && (mem_find_sec(as, va) == &hyp_secs[SEC_HYP_PRIVATE])) {
+        cpus = 1UL << cpu()->id;
+    }
+
+    return cpus;
+}
+
 static inline bool pte_allocable(struct addr_space* as, pte_t* pte, size_t lvl, size_t left,
     vaddr_t addr)
 {
@@ -298,6 +519,78 @@ static void mem_inflate_pt(struct addr_space* as, vaddr_t va, size_t length)
     }
 }
 
+#if defined(COLOR_CONTIG) && (PTE_CONTIG_NUM > 0)
+
+/**
+ * Colored mappings are built a page at a time. Still, the pages of a vm's colors are physically
+ * contiguous for as long as the colors are adjacent. Mark the runs of last level entries that map
+ * such pages, aligned both in the virtual and physical address spaces to the architecture's
+ * contiguous hint (aarch64's contiguous bit or Svnapot), so the tlb can hold each run as a single
+ * entry. Must be called with the as locked, on entries that were just set and not yet used.
+ */
+static void mem_map_contig(struct addr_space* as, vaddr_t va, size_t num_pages)
+{
+    size_t lvl = as->pt.dscr->lvls - 1;
+    size_t run_size = PTE_CONTIG_NUM * (size_t)PAGE_SIZE;
+    vaddr_t end = ALIGN_FLOOR(va + (num_pages * PAGE_SIZE), run_size);
+
+    if (as->type != AS_VM) {
+        return;
+    }
+
+    for (vaddr_t run = ALIGN(va, run_size); run < end; run += run_size) {
+        pte_t* pte = pt_get_pte(&as->pt, lvl, run);
+        paddr_t base = pte_addr(pte);
+        bool contig = pte_valid(pte) && ((base % run_size) == 0);
+        for (size_t i = 1; contig && (i < PTE_CONTIG_NUM); i++) {
+            contig = pte_valid(&pte[i]) && (pte_addr(&pte[i]) == (base + (i * PAGE_SIZE)));
+        }
+        if (contig) {
+            for (size_t i = 0; i < PTE_CONTIG_NUM; i++) {
+                pte_set_contig(&pte[i]);
+            }
+        }
+    }
+}
+
+/**
+ * Before any entry of a contiguous run changes, the whole run must be invalidated and its tlb
+ * entries flushed. The run is then rewritten as individual pages. Must be called with the as
+ * locked.
+ */
+static void mem_break_contig(struct addr_space* as, pte_t* pte, vaddr_t va)
+{
+    size_t lvl = as->pt.dscr->lvls - 1;
+    size_t index = pt_getpteindex(&as->pt, pte, lvl) % PTE_CONTIG_NUM;
+    pte_t* run = pte - index;
+    vaddr_t run_va = va - (index * PAGE_SIZE);
+    pte_t vals[PTE_CONTIG_NUM];
+
+    for (size_t i = 0; i < PTE_CONTIG_NUM; i++) {
+        vals[i] = pte_contig_clear(&run[i]);
+    }
+    for (size_t i = 0; i < PTE_CONTIG_NUM; i++) {
+        run[i] = PTE_INVALID;
+    }
+    fence_sync_write();
+    tlb_inv_range(as, run_va, PTE_CONTIG_NUM * PAGE_SIZE);
+    for (size_t i = 0; i < PTE_CONTIG_NUM; i++) {
+        run[i] = vals[i];
+    }
+    fence_sync_write();
+}
+
+#else
+
+static inline void mem_map_contig(struct addr_space* as, vaddr_t va, size_t num_pages)
+{
+    UNUSED_ARG(as);
+    UNUSED_ARG(va);
+    UNUSED_ARG(num_pages);
+}
+
+#endif
+
 vaddr_t mem_alloc_vpage(struct addr_space* as, enum AS_SEC section, vaddr_t at, size_t n)
 {
     size_t lvl = 0;
@@ -411,14 +704,57 @@ vaddr_t mem_alloc_vpage(struct addr_space* as, enum AS_SEC section, vaddr_t at,
     return vpage;
 }
 
+/**
+ * Frees the table at lvl holding the entry for va if none of its entries is in use, neither mapped
+ * nor reserved, and repeats for its parent, up to but excluding the root. Tables hanging directly
+ * from the root of a shared section are kept, as each cpu root holds its own copy of the entries
+ * pointing to them. Returns the level of the deepest table still in place for va. Must be called
+ * with the as lock held, as well as the section lock if the section is shared.
+ */
+static size_t mem_free_empty_pts(struct addr_space* as, struct section* sec, vaddr_t va,
+    size_t lvl)
+{
+    size_t min_lvl = sec->shared ? 2 : 1;
+
+    while (lvl >= min_lvl) {
+        pte_t* pt = pt_get(&as->pt, lvl, va);
+        for (size_t i = 0; i < pt_nentries(&as->pt, lvl); i++) {
+            if (pt[i] != PTE_INVALID) {
+                return lvl;
+            }
+        }
+
+        pte_t* parent = pt_get_pte(&as->pt, lvl - 1, va);
+        size_t parent_lvlsz = pt_lvlsize(&as->pt, lvl - 1);
+        struct ppages ppages = mem_ppages_get(pte_addr(parent), NUM_PAGES(pt_size(&as->pt, lvl)));
+
+        *parent = PTE_INVALID;
+        fence_sync_write();
+
+        /**
+         * Besides the walk caches for the range covered by the table, drop the hypervisor mapping
+         * through which it was accessed before handing the page back to the allocator.
+         */
+        tlb_inv_range(as, va & ~(parent_lvlsz - 1), parent_lvlsz);
+        tlb_inv_va(&cpu()->as, (vaddr_t)pt);
+        mem_free_ppages(&ppages);
+
+        lvl--;
+    }
+
+    return lvl;
+}
+
 void mem_unmap(struct addr_space* as, vaddr_t at, size_t num_pages, bool free_ppages)
 {
     vaddr_t vaddr = at;
     vaddr_t top = at + (num_pages * PAGE_SIZE);
     size_t lvl = 0;
+    struct tlb_batch batch;
 
     spin_lock(&as->lock);
 
+    tlb_batch_init(&batch, as);
     struct section* sec = mem_find_sec(as, at);
     if (sec->shared) {
         spin_lock(&sec->lock);
@@ -438,6 +774,9 @@ void mem_unmap(struct addr_space* as, vaddr_t at, size_t num_pages, bool free_pp
             size_t nentries = pt_nentries(&as->pt, lvl);
             size_t lvlsz = pt_lvlsize(&as->pt, lvl);
 
+            vaddr_t first = vaddr;
+            size_t pt_lvl = lvl;
+
             while ((entry < nentries) && (vaddr < top)) {
                 if (!pte_table(&as->pt, pte, lvl)) {
                     vaddr_t vpage_base = vaddr & ~(lvlsz - 1);
@@ -448,15 +787,22 @@ void mem_unmap(struct addr_space* as, vaddr_t at, size_t num_pages, bool free_pp
                         break;
                     }
 
-                    if (free_ppages) {
-                        paddr_t paddr = pte_addr(pte);
-                        struct ppages ppages = mem_ppages_get(paddr, lvlsz / PAGE_SIZE);
-                        mem_free_ppages(&ppages);
+#if defined(COLOR_CONTIG) && (PTE_CONTIG_NUM > 0)
+                    if ((lvl == (as->pt.dscr->lvls - 1)) && pte_contig(pte)) {
+                        mem_break_contig(as, pte, vaddr);
                     }
+#endif
 
+                    paddr_t paddr = pte_addr(pte);
                     *pte = 0;
-                    tlb_inv_va(&cpu()->as, vaddr);
+                    tlb_batch_add(&batch, vaddr, lvlsz);
 
+                    if (free_ppages) {
+                        /* No stale translation may be left once the pages are reused */
+                        tlb_batch_flush(&batch);
+                        struct ppages ppages = mem_ppages_get(paddr, lvlsz / PAGE_SIZE);
+                        mem_free_ppages(&ppages);
+                    }
                 } else {
                     break;
                 }
@@ -469,12 +815,14 @@ void mem_unmap(struct addr_space* as, vaddr_t at, size_t num_pages, bool free_pp
                 lvl--;
             }
 
-            /**
-             * TODO: check if the current pt is now empty and if so, free it too up to the root.
-             */
+            if (vaddr > first) {
+                lvl = min(lvl, mem_free_empty_pts(as, sec, first, pt_lvl));
+            }
         }
     }
 
+    tlb_batch_flush(&batch);
+
     if (sec->shared) {
         spin_unlock(&sec->lock);
     }
@@ -524,6 +872,7 @@ static bool mem_map(struct addr_space* as, vaddr_t va, struct ppages* ppages, si
             vaddr += PAGE_SIZE;
             index++;
         }
+        mem_map_contig(as, va, ppages->num_pages);
     } else {
         paddr_t paddr = ppages ? ppages->base : 0;
         while (count < num_pages) {
@@ -658,6 +1007,7 @@ bool mem_map_reclr(struct addr_space* as, vaddr_t va, struct ppages* ppages, siz
         phys_va += PAGE_SIZE;
         vaddr += PAGE_SIZE;
     }
+    mem_map_contig(as, va, num_pages);
 
     /**
      * Flush the newly allocated colored pages to which parts of the image was copied, and might
@@ -679,6 +1029,234 @@ bool mem_map_reclr(struct addr_space* as, vaddr_t va, struct ppages* ppages, siz
     return true;
 }
 
+/**
+ * Returns the last level entry for va, breaking down any superpage mapping it, or NULL if va is
+ * not mapped. Must be called with the as lock held.
+ */
+static pte_t* mem_page_pte(struct addr_space* as, vaddr_t va)
+{
+    size_t lvl = 0;
+    size_t last_lvl = as->pt.dscr->lvls - 1;
+
+    pte_t* pte = pt_get_pte(&as->pt, lvl, va);
+    while ((lvl < last_lvl) && pte_valid(pte) && pte_table(&as->pt, pte, lvl)) {
+        lvl++;
+        pte = pt_get_pte(&as->pt, lvl, va);
+    }
+
+    if (!pte_valid(pte)) {
+        return NULL;
+    }
+
+    if (lvl < last_lvl) {
+        for (; lvl < last_lvl; lvl++) {
+            mem_expand_pte(as, va, lvl);
+        }
+        tlb_inv_va(as, va);
+        pte = pt_get_pte(&as->pt, last_lvl, va);
+    }
+
+    return pte;
+}
+
+/**
+ * Replaces the page mapped by pte at va with a writable copy in a newly allocated page of the given
+ * colors. The original page is left for the caller to release. Returns false if no page could be
+ * allocated. Must be called with the as lock held.
+ */
+static bool mem_copy_page(struct addr_space* as, pte_t* pte, vaddr_t va, colormap_t colors)
+{
+#if defined(COLOR_CONTIG) && (PTE_CONTIG_NUM > 0)
+    if (pte_contig(pte)) {
+        mem_break_contig(as, pte, va);
+    }
+#endif
+
+    struct ppages new_ppages = mem_alloc_ppages(colors, 1, false);
+    if (new_ppages.num_pages < 1) {
+        return false;
+    }
+    paddr_t new_pa = new_ppages.base;
+    if (!all_clrs(new_ppages.colors)) {
+        new_pa += pp_next_clr(new_ppages.base, 0, new_ppages.colors) * PAGE_SIZE;
+    }
+    struct ppages old_page = mem_ppages_get(pte_addr(pte), 1);
+    struct ppages new_page = mem_ppages_get(new_pa, 1);
+
+    vaddr_t src = mem_alloc_map(&cpu()->as, SEC_HYP_PRIVATE, &old_page, INVALID_VA, 1,
+        PTE_HYP_FLAGS);
+    vaddr_t dst = mem_alloc_map(&cpu()->as, SEC_HYP_PRIVATE, &new_page, INVALID_VA, 1,
+        PTE_HYP_FLAGS);
+    if ((src == INVALID_VA) || (dst == INVALID_VA)) {
+        ERROR("failed to map pages for copying");
+    }
+
+    /**
+     * Break before make: the guest cannot access the page while it is copied, so it has to be
+     * ready to retry faulting accesses to it. The old entry keeps the page's attributes, its type
+     * bits included, so only its address and write permission are replaced.
+     */
+    pte_t old_pte = *pte;
+    *pte = PTE_INVALID;
+    fence_sync_write();
+    tlb_inv_va(as, va);
+
+    memcpy((void*)dst, (void*)src, PAGE_SIZE);
+    cache_flush_range(dst, PAGE_SIZE);
+
+    pte_set(pte, new_pa, 0, old_pte & PTE_FLAGS_MSK);
+    pte_set_rdonly(pte, false);
+    fence_sync_write();
+    /* Some architectures, e.g., riscv, allow invalid entries to be cached */
+    tlb_inv_va(as, va);
+
+    mem_unmap(&cpu()->as, src, 1, false);
+    mem_unmap(&cpu()->as, dst, 1, false);
+
+    return true;
+}
+
+bool mem_recolor_page(struct addr_space* as, vaddr_t va, colormap_t colors)
+{
+    bool ok = true;
+
+    if (all_clrs(colors)) {
+        return true;
+    }
+
+    spin_lock(&as->lock);
+
+    /* Read-only pages might be shared with other vms, so they are left in place */
+    pte_t* pte = mem_page_pte(as, va);
+    if ((pte != NULL) && !pte_rdonly(pte)) {
+        paddr_t pa = pte_addr(pte);
+        if (!bit_get(colors, (pa / PAGE_SIZE) / COLOR_SIZE % COLOR_NUM)) {
+            struct ppages old_page = mem_ppages_get(pa, 1);
+            ok = mem_copy_page(as, pte, va, colors);
+            if (ok) {
+                mem_free_ppages(&old_page);
+            }
+        }
+    }
+
+    spin_unlock(&as->lock);
+
+    return ok;
+}
+
+void mem_write_protect(struct addr_space* as, vaddr_t va, size_t num_pages)
+{
+    vaddr_t end = va + (num_pages * PAGE_SIZE);
+    size_t last_lvl = as->pt.dscr->lvls - 1;
+    struct tlb_batch batch;
+
+    spin_lock(&as->lock);
+
+    tlb_batch_init(&batch, as);
+    while (va < end) {
+        size_t lvl = 0;
+        pte_t* pte = pt_get_pte(&as->pt, lvl, va);
+        while ((lvl < last_lvl) && pte_valid(pte) && pte_table(&as->pt, pte, lvl)) {
+            lvl++;
+            pte = pt_get_pte(&as->pt, lvl, va);
+        }
+
+        size_t lvl_size = pt_lvlsize(&as->pt, lvl);
+        if (!pte_valid(pte)) {
+            va = ALIGN_FLOOR(va, lvl_size) + lvl_size;
+        } else if ((lvl < last_lvl) && ((va % lvl_size) != 0 || (end - va) < lvl_size)) {
+            /* The superpage is not fully covered by the range, so only part of it is protected */
+            mem_expand_pte(as, va, lvl);
+        } else {
+#if defined(COLOR_CONTIG) && (PTE_CONTIG_NUM > 0)
+            /* All entries of a run must keep the same attributes */
+            if ((lvl == last_lvl) && pte_contig(pte)) {
+                mem_break_contig(as, pte, va);
+            }
+#endif
+            pte_set_rdonly(pte, true);
+            tlb_batch_add(&batch, va, lvl_size);
+            va += lvl_size;
+        }
+    }
+    tlb_batch_flush(&batch);
+
+    spin_unlock(&as->lock);
+}
+
+bool mem_cow_page(struct addr_space* as, vaddr_t va)
+{
+    bool ok = true;
+
+    spin_lock(&as->lock);
+
+    /* Another cpu might have already copied the page, or it might not be mapped at all */
+    pte_t* pte = mem_page_pte(as, va);
+    if ((pte != NULL) && pte_rdonly(pte)) {
+        ok = mem_copy_page(as, pte, va, as->colors);
+    }
+
+    spin_unlock(&as->lock);
+
+    return ok;
+}
+
+/* Returns the entry mapping va, at whatever level, or NULL. Must be called with the as locked. */
+static pte_t* mem_lookup_pte(struct addr_space* as, vaddr_t va)
+{
+    size_t lvl = 0;
+    size_t last_lvl = as->pt.dscr->lvls - 1;
+
+    pte_t* pte = pt_get_pte(&as->pt, lvl, va);
+    while ((lvl < last_lvl) && pte_valid(pte) && pte_table(&as->pt, pte, lvl)) {
+        lvl++;
+        pte = pt_get_pte(&as->pt, lvl, va);
+    }
+
+    return pte_valid(pte) ? pte : NULL;
+}
+
+bool mem_is_mapped(struct addr_space* as, vaddr_t va, bool write)
+{
+    spin_lock(&as->lock);
+    pte_t* pte = mem_lookup_pte(as, va);
+    bool mapped = (pte != NULL) && (!write || !pte_rdonly(pte));
+    spin_unlock(&as->lock);
+
+    return mapped;
+}
+
+bool mem_populate(struct addr_space* as, enum AS_SEC section, vaddr_t at, size_t num_pages,
+    mem_flags_t flags)
+{
+    /* Ranges are always populated as a whole, so another cpu might have done it already */
+    if (mem_is_mapped(as, at, false)) {
+        return true;
+    }
+
+    struct ppages ppages = mem_alloc_ppages(as->colors, num_pages, false);
+    if (ppages.num_pages < num_pages) {
+        return false;
+    }
+
+    /* Pages come back to the pools as their last owner left them, so they must be scrubbed */
+    vaddr_t va = mem_alloc_map(&cpu()->as, SEC_HYP_PRIVATE, &ppages, INVALID_VA, num_pages,
+        PTE_HYP_FLAGS);
+    if (va == INVALID_VA) {
+        ERROR("failed to map pages for clearing");
+    }
+    memset((void*)va, 0, num_pages * PAGE_SIZE);
+    cache_flush_range(va, num_pages * PAGE_SIZE);
+    mem_unmap(&cpu()->as, va, num_pages, false);
+
+    /* The range can still be taken if another cpu is populating it at the same time */
+    if (mem_alloc_map(as, section, &ppages, at, num_pages, flags) == INVALID_VA) {
+        mem_free_ppages(&ppages);
+    }
+
+    return true;
+}
+
 vaddr_t mem_map_cpy(struct addr_space* ass, struct addr_space* asd, vaddr_t vas, vaddr_t vad,
     size_t num_pages)
 {
@@ -749,9 +1327,7 @@ void mem_color_hypervisor(const paddr_t load_addr, struct mem_region* root_regio
     size_t vm_image_size = (size_t)(&_vm_image_end - &_vm_image_start);
     size_t cpu_boot_size = mem_cpu_boot_alloc_size();
     struct page_pool* root_pool = &root_region->page_pool;
-    size_t bitmap_size =
-        (root_pool->size / (8 * PAGE_SIZE) + !!(root_pool->size % (8 * PAGE_SIZE) != 0)) *
-        PAGE_SIZE;
+    size_t bitmap_size = pp_bitmap_size(root_pool) * PAGE_SIZE;
     colormap_t colors = config.hyp.colors;
 
     /* Set hypervisor colors in current address space */
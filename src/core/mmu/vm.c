@@ -7,8 +7,177 @@
 
 #include <config.h>
 #include <mem.h>
+#include <cpu.h>
+#include <hypercall.h>
+#include <fences.h>
+
+/**
+ * Recoloring state, kept outside struct vm as it is driven by a vm that cannot access another's
+ * hypervisor mappings. The pages themselves are moved by a cpu of the recolored vm, a bounded
+ * batch at a time, so that its guest only stalls for as long as a batch takes.
+ */
+static struct vm_recolor {
+    spinlock_t lock;
+    cpuid_t cpu;
+    colormap_t colors;
+    size_t budget;
+    size_t scanned;
+    volatile bool busy;
+    bool error;
+} vm_recolor[CONFIG_VM_NUM];
+
+enum { VM_RECOLOR_BATCH };
+
+/* Most pages moved per batch, whatever the budget asked for */
+#define VM_RECOLOR_MAX_BATCH (64)
+
+static bool vm_recolor_region(const struct vm_mem_region* reg)
+{
+    return !reg->place_phys;
+}
+
+static size_t vm_recolor_pages(const struct vm_config* vm_config)
+{
+    size_t pages = 0;
+    for (size_t i = 0; i < vm_config->platform.region_num; i++) {
+        struct vm_mem_region* reg = &vm_config->platform.regions[i];
+        if (vm_recolor_region(reg)) {
+            pages += NUM_PAGES(reg->size);
+        }
+    }
+    return pages;
+}
+
+static void vm_recolor_batch(struct vm* vm, struct vm_recolor* rc)
+{
+    const struct vm_config* vm_config = vm->config;
+    size_t skip = rc->scanned;
+    size_t budget = rc->budget;
+
+    /* New allocations, i.e., lazily populated pages, follow the new colors from now on */
+    vm->as.colors = rc->colors;
+    vm->recolored = true;
+
+    for (size_t i = 0; (i < vm_config->platform.region_num) && (budget > 0); i++) {
+        struct vm_mem_region* reg = &vm_config->platform.regions[i];
+        size_t n = NUM_PAGES(reg->size);
+        if (!vm_recolor_region(reg)) {
+            continue;
+        } else if (skip >= n) {
+            skip -= n;
+            continue;
+        }
+
+        for (size_t pg = skip; (pg < n) && (budget > 0); pg++, budget--) {
+            if (!mem_recolor_page(&vm->as, reg->base + (pg * PAGE_SIZE), rc->colors)) {
+                rc->error = true;
+                return;
+            }
+            rc->scanned++;
+        }
+        skip = 0;
+    }
+}
+
+static void vm_recolor_handler(uint32_t event, uint64_t data)
+{
+    struct vm_recolor* rc = &vm_recolor[data];
+
+    switch (event) {
+        case VM_RECOLOR_BATCH:
+            vm_recolor_batch(cpu()->vcpu->vm, rc);
+            break;
+        default:
+            WARNING("Unknown vm recolor event");
+            break;
+    }
+
+    fence_ord_write();
+    rc->busy = false;
+}
+CPU_MSG_HANDLER(vm_recolor_handler, VM_RECOLOR_CPUMSG_ID)
+
+long int vm_recolor_hypercall(unsigned long vm_id, unsigned long colors, unsigned long budget)
+{
+    long int ret;
+
+    if (!cpu()->vcpu->vm->config->color_mgmt) {
+        return -HC_E_FAILURE;
+    } else if ((vm_id >= config.vmlist_size) || (budget == 0) || all_clrs((colormap_t)colors)) {
+        return -HC_E_INVAL_ARGS;
+    }
+
+    const struct vm_config* vm_config = &config.vmlist[vm_id];
+    struct vm_recolor* rc = &vm_recolor[vm_id];
+
+    spin_lock(&rc->lock);
+
+    if ((colormap_t)colors != rc->colors) {
+        if (rc->busy) {
+            spin_unlock(&rc->lock);
+            return -HC_E_FAILURE;
+        }
+        rc->colors = (colormap_t)colors;
+        rc->scanned = 0;
+        rc->error = false;
+    }
+
+    bool busy = rc->busy;
+    fence_ord_read();
+    size_t remaining = vm_recolor_pages(vm_config) - rc->scanned;
+    if (rc->error) {
+        ret = -HC_E_FAILURE;
+    } else if (busy || (remaining == 0)) {
+        ret = (long int)remaining;
+    } else {
+        rc->budget = min(budget, (unsigned long)VM_RECOLOR_MAX_BATCH);
+        rc->busy = true;
+        struct cpu_msg msg = { (uint32_t)VM_RECOLOR_CPUMSG_ID, VM_RECOLOR_BATCH, vm_id };
+        cpu_send_msg(rc->cpu, &msg);
+        ret = (long int)remaining;
+    }
+
+    spin_unlock(&rc->lock);
+
+    return ret;
+}
+
+#if defined(COLOR_CONTIG) && (PTE_CONTIG_NUM > 0)
+/**
+ * Colors keep the cache's granularity, so a contiguous run of pages spans several colors. Runs
+ * are only formed where a vm has all the colors spanned by an aligned run.
+ */
+static bool vm_colors_contig(colormap_t colors)
+{
+    size_t period = max(COLOR_NUM * COLOR_SIZE, (size_t)PTE_CONTIG_NUM);
+    for (size_t run = 0; run < period; run += PTE_CONTIG_NUM) {
+        bool contig = true;
+        for (size_t pg = run; contig && (pg < (run + PTE_CONTIG_NUM)); pg++) {
+            contig = bit_get(colors, (pg / COLOR_SIZE) % COLOR_NUM) != 0;
+        }
+        if (contig) {
+            return true;
+        }
+    }
+    return false;
+}
+#endif
 
 void vm_mem_prot_init(struct vm* vm, const struct vm_config* vm_config)
 {
     as_init(&vm->as, AS_VM, vm->id, NULL, vm_config->colors);
+
+#if defined(COLOR_CONTIG) && (PTE_CONTIG_NUM > 0)
+    if (!all_clrs(vm->as.colors) && !vm_colors_contig(vm->as.colors)) {
+        WARNING("vm %d colors never span a contiguous run of %d pages, so COLOR_CONTIG has no "
+                "effect on it",
+            vm->id, PTE_CONTIG_NUM);
+    }
+#endif
+
+    struct vm_recolor* rc = &vm_recolor[vm->id];
+    rc->lock = SPINLOCK_INITVAL;
+    rc->cpu = vm->master;
+    rc->colors = vm_config->colors;
+    rc->scanned = vm_recolor_pages(vm_config);
 }
@@ -208,7 +208,7 @@ static void mem_free_ppages(struct ppages* ppages)
         spin_lock(&pool->lock);
         if (in_range(ppages->base, pool->base, pool->size * PAGE_SIZE)) {
             size_t index = (ppages->base - pool->base) / PAGE_SIZE;
-            bitmap_clear_consecutive(pool->bitmap, index, ppages->num_pages);
+            pp_mark_free(pool, index, ppages->num_pages);
         }
         spin_unlock(&pool->lock);
     }
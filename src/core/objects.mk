@@ -3,6 +3,7 @@
 
 core-objs-y+=init.o
 core-objs-y+=mem.o
+core-objs-$(PP_BUDDY)+=buddy.o
 core-objs-y+=cache.o
 core-objs-y+=interrupts.o
 core-objs-y+=cpu.o
@@ -14,3 +15,8 @@ core-objs-y+=ipc.o
 core-objs-y+=objpool.o
 core-objs-y+=hypercall.o
 core-objs-y+=shmem.o
+core-objs-y+=vconsole.o
+core-objs-$(BOOT_PROF)+=boot_prof.o
+core-objs-$(TRAP_STATS)+=trap_stats.o
+core-objs-$(TRACE)+=trace.o
+core-objs-$(MEMGUARD)+=memguard.o
@@ -4,24 +4,142 @@
  */
 
 #include <objpool.h>
+#include <cpu.h>
+#include <platform.h>
 #include <string.h>
 
 void objpool_init(struct objpool* objpool)
 {
     memset(objpool->pool, 0, objpool->objsize * objpool->num);
-    memset(objpool->bitmap, 0, BITMAP_SIZE(objpool->num));
+    memset(objpool->next, 0, sizeof(size_t) * objpool->num);
+    memset(objpool->caches, 0, sizeof(struct objpool_cache) * PLAT_CPU_NUM);
+    objpool->free_head = 0;
+    objpool->fresh = 0;
+    objpool->used = 0;
+    objpool->used_hwm = 0;
+}
+
+static inline void* objpool_obj(struct objpool* objpool, size_t n)
+{
+    return (void*)((uintptr_t)objpool->pool + (objpool->objsize * n));
+}
+
+/* Must hold the pool lock */
+static void* objpool_pop(struct objpool* objpool)
+{
+    size_t n;
+
+    if (objpool->free_head != 0) {
+        n = objpool->free_head - 1;
+        objpool->free_head = objpool->next[n];
+    } else if (objpool->fresh < objpool->num) {
+        n = objpool->fresh++;
+    } else {
+        return NULL;
+    }
+
+    return objpool_obj(objpool, n);
+}
+
+/* Must hold the pool lock */
+static void objpool_push(struct objpool* objpool, void* obj)
+{
+    size_t n = ((vaddr_t)obj - (vaddr_t)objpool->pool) / objpool->objsize;
+    objpool->next[n] = objpool->free_head;
+    objpool->free_head = n + 1;
+}
+
+static inline size_t objpool_cache_batch(struct objpool* objpool)
+{
+    return max(objpool->cache_len / 2, 1UL);
+}
+
+/**
+ * Must hold the pool lock. The per-cpu counts are read while their cpus keep updating them, so
+ * the sum is only a snapshot.
+ */
+static size_t objpool_used(struct objpool* objpool)
+{
+    long used = objpool->used;
+    if (objpool->cache_len > 0) {
+        for (cpuid_t i = 0; i < platform.cpu_num; i++) {
+            used += objpool->caches[i].used;
+        }
+    }
+    return (size_t)max(used, 0L);
+}
+
+/* Must hold the pool lock */
+static void objpool_sample_hwm(struct objpool* objpool)
+{
+    objpool->used_hwm = max(objpool->used_hwm, objpool_used(objpool));
+}
+
+/**
+ * Takes a single object from the cache of any other cpu. Only used when the shared free list is
+ * empty, so that objects sitting in other cpus' caches never make an allocation fail.
+ */
+static void* objpool_steal(struct objpool* objpool)
+{
+    void* obj = NULL;
+
+    for (cpuid_t i = 0; (i < platform.cpu_num) && (obj == NULL); i++) {
+        struct objpool_cache* cache = &objpool->caches[i];
+        if ((i == cpu()->id) || (cache->num == 0)) {
+            continue;
+        }
+        spin_lock(&cache->lock);
+        if (cache->num > 0) {
+            obj = cache->objs[--cache->num];
+        }
+        spin_unlock(&cache->lock);
+    }
+
+    return obj;
 }
 
 void* objpool_alloc(struct objpool* objpool)
 {
     void* obj = NULL;
-    spin_lock(&objpool->lock);
-    ssize_t n = bitmap_find_nth(objpool->bitmap, objpool->num, 1, 0, false);
-    if (n >= 0) {
-        bitmap_set(objpool->bitmap, (size_t)n);
-        obj = (void*)((uintptr_t)objpool->pool + (objpool->objsize * (size_t)n));
+
+    if (objpool->cache_len == 0) {
+        spin_lock(&objpool->lock);
+        obj = objpool_pop(objpool);
+        if (obj != NULL) {
+            objpool->used++;
+            objpool_sample_hwm(objpool);
+        }
+        spin_unlock(&objpool->lock);
+    } else {
+        struct objpool_cache* cache = &objpool->caches[cpu()->id];
+        spin_lock(&cache->lock);
+        if (cache->num == 0) {
+            /* Refill half of the cache from the shared free list in a single critical section */
+            size_t batch = objpool_cache_batch(objpool);
+            spin_lock(&objpool->lock);
+            while ((cache->num < batch) && ((obj = objpool_pop(objpool)) != NULL)) {
+                cache->objs[cache->num++] = obj;
+            }
+            objpool_sample_hwm(objpool);
+            spin_unlock(&objpool->lock);
+        }
+        obj = NULL;
+        if (cache->num > 0) {
+            obj = cache->objs[--cache->num];
+        }
+        spin_unlock(&cache->lock);
+
+        /* Never hold our own cache lock while taking another's */
+        if (obj == NULL) {
+            obj = objpool_steal(objpool);
+        }
+
+        /* Only ever written by its own cpu, so no lock is needed */
+        if (obj != NULL) {
+            cache->used++;
+        }
     }
-    spin_unlock(&objpool->lock);
+
     return obj;
 }
 
@@ -31,12 +149,41 @@ void objpool_free(struct objpool* objpool, void* obj)
     vaddr_t pool_addr = (vaddr_t)objpool->pool;
     bool in_pool = in_range(obj_addr, pool_addr, objpool->objsize * objpool->num);
     bool aligned = IS_ALIGNED(obj_addr - pool_addr, objpool->objsize);
-    if (in_pool && aligned) {
-        size_t n = (obj_addr - pool_addr) / objpool->objsize;
+    if (!in_pool || !aligned) {
+        WARNING("leaked while trying to free stray object");
+        return;
+    }
+
+    if (objpool->cache_len == 0) {
         spin_lock(&objpool->lock);
-        bitmap_clear(objpool->bitmap, n);
+        objpool_push(objpool, obj);
+        objpool->used--;
+        spin_unlock(&objpool->lock);
+        return;
+    }
+
+    struct objpool_cache* cache = &objpool->caches[cpu()->id];
+    cache->used--;
+    spin_lock(&cache->lock);
+    if (cache->num >= objpool->cache_len) {
+        /* Return half of the cache to the shared free list in a single critical section */
+        size_t batch = objpool_cache_batch(objpool);
+        spin_lock(&objpool->lock);
+        while (cache->num > objpool->cache_len - batch) {
+            objpool_push(objpool, cache->objs[--cache->num]);
+        }
         spin_unlock(&objpool->lock);
-    } else {
-        WARNING("leaked while trying to free stray object");
     }
+    cache->objs[cache->num++] = obj;
+    spin_unlock(&cache->lock);
+}
+
+void objpool_get_stats(struct objpool* objpool, struct objpool_stats* stats)
+{
+    spin_lock(&objpool->lock);
+    objpool_sample_hwm(objpool);
+    stats->num = objpool->num;
+    stats->used = objpool_used(objpool);
+    stats->used_hwm = objpool->used_hwm;
+    spin_unlock(&objpool->lock);
 }
@@ -0,0 +1,110 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <trace.h>
+#include <cpu.h>
+#include <mem.h>
+#include <config.h>
+#include <fences.h>
+#include <platform.h>
+#include <string.h>
+
+static struct trace_ring* trace_rings[PLAT_CPU_NUM];
+static size_t trace_ring_mask;
+
+/**
+ * Returns how many events fit in each cpu's ring in the given shared memory.
+ */
+static size_t trace_ring_events(struct shmem* shmem)
+{
+    if (shmem->size <= sizeof(struct trace_hdr)) {
+        return 0;
+    }
+
+    size_t share = (shmem->size - sizeof(struct trace_hdr)) / platform.cpu_num;
+    if (share <= sizeof(struct trace_ring)) {
+        return 0;
+    }
+
+    /* Keep the number of events a power of two so the head can simply wrap around */
+    size_t avail = (share - sizeof(struct trace_ring)) / sizeof(struct trace_event);
+    size_t events = 0;
+    if (avail > 0) {
+        events = 1;
+        while ((events * 2) <= avail) {
+            events *= 2;
+        }
+    }
+
+    return events;
+}
+
+static struct shmem* trace_shmem_get(void)
+{
+    for (size_t i = 0; i < config.shmemlist_size; i++) {
+        if (config.shmemlist[i].trace) {
+            return &config.shmemlist[i];
+        }
+    }
+    return NULL;
+}
+
+void trace_init(void)
+{
+    if (cpu_is_master()) {
+        struct shmem* shmem = trace_shmem_get();
+        size_t ring_events = (shmem != NULL) ? trace_ring_events(shmem) : 0;
+
+        if (ring_events == 0) {
+            WARNING("no shared memory region fit for the trace rings, tracing disabled");
+        } else {
+            size_t num_pages = NUM_PAGES(shmem->size);
+            struct ppages ppages = mem_ppages_get(shmem->phys, num_pages);
+            ppages.colors = shmem->colors;
+            vaddr_t va = mem_alloc_map(&cpu()->as, SEC_HYP_GLOBAL, &ppages, INVALID_VA, num_pages,
+                PTE_HYP_FLAGS);
+            if (va == INVALID_VA) {
+                ERROR("failed to map the trace rings");
+            }
+
+            size_t ring_size =
+                sizeof(struct trace_ring) + (ring_events * sizeof(struct trace_event));
+            struct trace_hdr* hdr = (struct trace_hdr*)va;
+            memset((void*)va, 0, sizeof(struct trace_hdr) + (platform.cpu_num * ring_size));
+            hdr->magic = TRACE_MAGIC;
+            hdr->version = TRACE_VERSION;
+            hdr->freq = timestamp_freq();
+            hdr->cpu_num = (uint32_t)platform.cpu_num;
+            hdr->ring_size = (uint32_t)ring_size;
+
+            trace_ring_mask = ring_events - 1;
+            for (cpuid_t cpu_id = 0; cpu_id < platform.cpu_num; cpu_id++) {
+                trace_rings[cpu_id] =
+                    (struct trace_ring*)(va + sizeof(struct trace_hdr) + (cpu_id * ring_size));
+            }
+        }
+    }
+
+    /* On MPU systems, the other cpus must first handle the broadcast of the new mapping */
+    cpu_sync_and_clear_msgs(&cpu_glb_sync);
+}
+
+void trace_event_at(uint64_t ts, enum trace_event_id id, uint32_t arg0, uint64_t arg1)
+{
+    struct trace_ring* ring = trace_rings[cpu()->id];
+
+    if (ring == NULL) {
+        return;
+    }
+
+    uint64_t head = ring->head;
+    struct trace_event* event = &ring->events[head & trace_ring_mask];
+    event->ts = ts;
+    event->id = (uint32_t)id;
+    event->arg0 = arg0;
+    event->arg1 = arg1;
+    fence_ord_write();
+    ring->head = head + 1;
+}
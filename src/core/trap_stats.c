@@ -0,0 +1,103 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <trap_stats.h>
+#include <cpu.h>
+#include <vm.h>
+#include <mem.h>
+#include <config.h>
+#include <string.h>
+#include <hypercall.h>
+#include <arch/timestamp.h>
+
+uint64_t trap_stats_begin(void)
+{
+    return timestamp_get();
+}
+
+void trap_stats_end(enum trap_stat stat, uint64_t begin)
+{
+    uint64_t ticks = timestamp_get() - begin;
+    struct vcpu* vcpu = cpu()->vcpu;
+
+    /* Interrupts might be taken before the cpu is running any vcpu */
+    if (vcpu == NULL) {
+        return;
+    }
+
+    size_t bin = 0;
+    for (uint64_t t = ticks >> 1; (t > 0) && (bin < (TRAP_STATS_HIST_BINS - 1)); t >>= 1) {
+        bin++;
+    }
+
+    vcpu->stats.count[stat]++;
+    vcpu->stats.ticks[stat] += ticks;
+    vcpu->stats.hist[stat][bin]++;
+}
+
+static bool trap_stats_buffer_valid(struct vm* vm, vaddr_t addr, size_t size)
+{
+    for (size_t i = 0; i < vm->config->platform.region_num; i++) {
+        struct vm_mem_region* reg = &vm->config->platform.regions[i];
+        if (range_in_range(addr, size, reg->base, reg->size)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+long int trap_stats_hypercall(unsigned long addr, unsigned long size)
+{
+    struct vm* vm = cpu()->vcpu->vm;
+    size_t snapshot_size =
+        sizeof(struct trap_stats_snapshot) + (vm->cpu_num * sizeof(struct trap_stats));
+
+    if ((size < snapshot_size) || !trap_stats_buffer_valid(vm, addr, snapshot_size)) {
+        return -HC_E_INVAL_ARGS;
+    }
+
+    /**
+     * Pages not yet populated in a lazy region, or still shared with other vms in a shared image,
+     * are handled as if the guest itself wrote to them.
+     */
+    for (vaddr_t va = ALIGN_FLOOR(addr, (vaddr_t)PAGE_SIZE); va < (addr + snapshot_size);
+         va += PAGE_SIZE) {
+        if (DEFINED(MEM_PROT_MMU) && !mem_is_mapped(&vm->as, va, true) &&
+            !vm_mem_fault(vm, max(va, addr))) {
+            return -HC_E_FAILURE;
+        }
+    }
+
+    /**
+     * The buffer's pages must not be moved, and freed, by a recoloring while they are written.
+     * Only mmu systems recolor vms, and on mpu ones mem_map_cpy takes the lock itself.
+     */
+    if (DEFINED(MEM_PROT_MMU)) {
+        spin_lock(&vm->as.lock);
+    }
+
+    vaddr_t page = ALIGN_FLOOR(addr, (vaddr_t)PAGE_SIZE);
+    size_t num_pages = NUM_PAGES((addr + snapshot_size) - page);
+    vaddr_t va = mem_map_cpy(&vm->as, &cpu()->as, page, INVALID_VA, num_pages);
+    struct trap_stats_snapshot* snapshot = (struct trap_stats_snapshot*)(va + (addr - page));
+
+    snapshot->freq = timestamp_freq();
+    snapshot->vcpu_num = vm->cpu_num;
+    for (vcpuid_t vcpuid = 0; vcpuid < vm->cpu_num; vcpuid++) {
+        struct vcpu* vcpu = vm_get_vcpu(vm, vcpuid);
+        struct cpu_msg_stats* msg_stats = &cpu_if(vcpu->phys_id)->msg_stats;
+        memcpy(&snapshot->vcpu[vcpuid], &vcpu->stats, sizeof(struct trap_stats));
+        snapshot->vcpu[vcpuid].ipis_sent = msg_stats->ipis_sent;
+        snapshot->vcpu[vcpuid].ipis_coalesced = msg_stats->ipis_coalesced;
+    }
+
+    mem_unmap(&cpu()->as, va, num_pages, false);
+
+    if (DEFINED(MEM_PROT_MMU)) {
+        spin_unlock(&vm->as.lock);
+    }
+
+    return HC_E_SUCCESS;
+}
@@ -0,0 +1,121 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <vconsole.h>
+#include <cpu.h>
+#include <vm.h>
+#include <mem.h>
+#include <config.h>
+#include <hypercall.h>
+#include <fences.h>
+#include <string.h>
+
+void vconsole_init(struct vm* vm, const struct vm_config* vm_config)
+{
+    struct vconsole* vcon = &vm->vconsole;
+    vaddr_t base = vm_config->platform.vconsole.base;
+    size_t size = vm_config->platform.vconsole.size;
+
+    vcon->lock = SPINLOCK_INITVAL;
+    vcon->ring = NULL;
+    vcon->size = 0;
+    vcon->tail = 0;
+    vcon->line_len = 0;
+
+    if (size == 0) {
+        return;
+    }
+
+    if (size <= sizeof(struct vconsole_ring)) {
+        WARNING("vm %d vconsole too small. Ignored.", vm->id);
+        return;
+    }
+
+    size_t num_pages = NUM_PAGES(size);
+    struct ppages ppages = mem_alloc_ppages(vm->as.colors, num_pages, false);
+    if (ppages.num_pages < num_pages) {
+        ERROR("failed to allocate vm %d vconsole", vm->id);
+    }
+
+    vaddr_t va = mem_alloc_map(&cpu()->as, SEC_HYP_VM, &ppages, INVALID_VA, num_pages,
+        PTE_HYP_FLAGS);
+    if (va == INVALID_VA) {
+        ERROR("failed to map vm %d vconsole", vm->id);
+    }
+
+    if (mem_alloc_map(&vm->as, SEC_VM_ANY, &ppages, base, num_pages, PTE_VM_FLAGS) != base) {
+        ERROR("failed to map vm %d vconsole at 0x%lx", vm->id, base);
+    }
+
+    /* Keep the data size a power of two so the guest can simply wrap around */
+    size_t avail = size - sizeof(struct vconsole_ring);
+    uint32_t data_size = 1;
+    while ((data_size * 2UL) <= avail && (data_size * 2UL) <= UINT32_MAX) {
+        data_size *= 2;
+    }
+
+    struct vconsole_ring* ring = (struct vconsole_ring*)va;
+    memset(ring, 0, sizeof(struct vconsole_ring));
+    ring->size = data_size;
+    vcon->size = data_size;
+    vcon->ring = ring;
+}
+
+static void vconsole_flush_line(struct vm* vm, struct vconsole* vcon)
+{
+    vcon->line[vcon->line_len] = '\0';
+    console_printk("[vm%d] %s\n", vm->id, vcon->line);
+    vcon->line_len = 0;
+}
+
+static void vconsole_putc(struct vm* vm, struct vconsole* vcon, char c)
+{
+    if (c == '\n') {
+        vconsole_flush_line(vm, vcon);
+    } else if ((c != '\r') && (c != '\0')) {
+        vcon->line[vcon->line_len++] = c;
+        if (vcon->line_len >= (VCONSOLE_LINE_LEN - 1)) {
+            vconsole_flush_line(vm, vcon);
+        }
+    }
+}
+
+long int vconsole_hypercall(void)
+{
+    struct vm* vm = cpu()->vcpu->vm;
+    struct vconsole* vcon = &vm->vconsole;
+    struct vconsole_ring* ring = vcon->ring;
+
+    if (ring == NULL) {
+        return -HC_E_FAILURE;
+    }
+
+    spin_lock(&vcon->lock);
+
+    /* Only the head is read from the ring, the guest might have overwritten anything else */
+    uint32_t size = vcon->size;
+    uint32_t tail = vcon->tail;
+    uint32_t head = ring->head;
+    fence_ord_read();
+
+    if ((uint32_t)(head - tail) > size) {
+        WARNING("vm %d vconsole overrun", vm->id);
+        tail = head - size;
+    }
+
+    uint32_t end = tail + min((uint32_t)(head - tail), (uint32_t)VCONSOLE_HC_BUDGET);
+    while (tail != end) {
+        vconsole_putc(vm, vcon, ring->data[tail & (size - 1)]);
+        tail++;
+    }
+
+    vcon->tail = tail;
+    fence_ord_write();
+    ring->tail = tail;
+
+    spin_unlock(&vcon->lock);
+
+    return HC_E_SUCCESS;
+}
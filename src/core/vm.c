@@ -9,6 +9,7 @@
 #include <cache.h>
 #include <config.h>
 #include <shmem.h>
+#include <boot_prof.h>
 
 static void vm_master_init(struct vm* vm, const struct vm_config* vm_config, vmid_t vm_id)
 {
@@ -95,9 +96,15 @@ static void vm_map_img_rgn_inplace(struct vm* vm, const struct vm_config* vm_con
         /* map img in place */
         mem_alloc_map(&vm->as, SEC_VM_ANY, &pa_img, img_base, n_img, PTE_VM_FLAGS);
         /* we are mapping in place, config is already reserved */
+        if (config_vm_img_shared(vm_config)) {
+            /* other vms might map the same pages, so writes are trapped and copied on */
+            mem_write_protect(&vm->as, img_base, n_img);
+        }
     } else {
         /* recolour img */
+        uint64_t reclr_begin = boot_prof_begin();
         mem_map_reclr(&vm->as, img_base, &pa_img, n_img, PTE_VM_FLAGS);
+        boot_prof_end(BOOT_PROF_MEM_MAP_RECLR, reclr_begin);
     }
     /* map pages after img */
     mem_alloc_map(&vm->as, SEC_VM_ANY, NULL, img_base + NUM_PAGES(img_size) * PAGE_SIZE, n_aft,
@@ -131,16 +138,46 @@ static void vm_install_image(struct vm* vm, struct vm_mem_region* reg)
         img_num_pages, PTE_HYP_FLAGS);
     vaddr_t dst_va =
         mem_map_cpy(&vm->as, &cpu()->as, vm->config->image.base_addr, INVALID_VA, img_num_pages);
-    memcpy((void*)dst_va, (void*)src_va, vm->config->image.size);
-    cache_flush_range((vaddr_t)dst_va, vm->config->image.size);
-    mem_unmap(&cpu()->as, src_va, img_num_pages, false);
-    mem_unmap(&cpu()->as, dst_va, img_num_pages, false);
+
+    /**
+     * Both mappings are in the global hypervisor section, so they are visible to all the vm's
+     * cpus, which will split the copy among themselves in vm_install_image_copy.
+     */
+    vm->install.src = src_va;
+    vm->install.dst = dst_va;
+    vm->install.size = vm->config->image.size;
+}
+
+/**
+ * Copies and flushes this cpu's share of the image set up by vm_install_image. The image is split
+ * in page aligned chunks, one per vcpu, so that no two cpus ever touch the same cache line.
+ */
+static void vm_install_image_copy(struct vm* vm)
+{
+    size_t chunk = ALIGN(ALIGN(vm->install.size, vm->cpu_num) / vm->cpu_num, PAGE_SIZE);
+    size_t offset = cpu()->vcpu->id * chunk;
+
+    if (offset < vm->install.size) {
+        size_t size = min(chunk, vm->install.size - offset);
+        uint64_t install_begin = boot_prof_begin();
+        memcpy((void*)(vm->install.dst + offset), (void*)(vm->install.src + offset), size);
+        cache_flush_range(vm->install.dst + offset, size);
+        boot_prof_end(BOOT_PROF_VM_INSTALL_IMAGE, install_begin);
+    }
+}
+
+static void vm_install_image_finish(struct vm* vm)
+{
+    size_t img_num_pages = NUM_PAGES(vm->install.size);
+    mem_unmap(&cpu()->as, vm->install.src, img_num_pages, false);
+    mem_unmap(&cpu()->as, vm->install.dst, img_num_pages, false);
+    vm->install.size = 0;
 }
 
 static void vm_map_img_rgn(struct vm* vm, const struct vm_config* vm_config,
     struct vm_mem_region* reg)
 {
-    if (!reg->place_phys && vm_config->image.inplace) {
+    if (!reg->place_phys && (vm_config->image.inplace || config_vm_img_shared(vm_config))) {
         vm_map_img_rgn_inplace(vm, vm_config, reg);
     } else {
         vm_map_mem_region(vm, reg);
@@ -148,20 +185,76 @@ static void vm_map_img_rgn(struct vm* vm, const struct vm_config* vm_config,
     }
 }
 
+static bool vm_mem_region_is_img(const struct vm_config* vm_config, struct vm_mem_region* reg)
+{
+    return range_in_range(vm_config->image.base_addr, vm_config->image.size, reg->base, reg->size);
+}
+
+static bool vm_mem_region_is_lazy(const struct vm_config* vm_config, struct vm_mem_region* reg)
+{
+    /**
+     * Regions placed at a fixed physical address have nothing to allocate, and the image region
+     * must be mapped for the image to be installed. Note that on MPU systems all regions are
+     * placed.
+     */
+    return reg->lazy && !reg->place_phys && !vm_mem_region_is_img(vm_config, reg);
+}
+
 static void vm_init_mem_regions(struct vm* vm, const struct vm_config* vm_config)
 {
     for (size_t i = 0; i < vm_config->platform.region_num; i++) {
         struct vm_mem_region* reg = &vm_config->platform.regions[i];
-        bool img_is_in_rgn =
-            range_in_range(vm_config->image.base_addr, vm_config->image.size, reg->base, reg->size);
-        if (img_is_in_rgn) {
+        if (vm_mem_region_is_img(vm_config, reg)) {
             vm_map_img_rgn(vm, vm_config, reg);
-        } else {
+        } else if (!vm_mem_region_is_lazy(vm_config, reg)) {
             vm_map_mem_region(vm, reg);
         }
     }
 }
 
+bool vm_mem_fault(struct vm* vm, vaddr_t addr)
+{
+    const struct vm_config* vm_config = vm->config;
+
+    for (size_t i = 0; i < vm_config->platform.region_num; i++) {
+        struct vm_mem_region* reg = &vm_config->platform.regions[i];
+        if (!in_range(addr, reg->base, reg->size)) {
+            continue;
+        } else if (config_vm_img_shared(vm_config) && !reg->place_phys &&
+            in_range(addr, vm_config->image.base_addr, vm_config->image.size)) {
+            /**
+             * A write to a page of a shared image, unless it was already copied meanwhile. If no
+             * page is left for the copy, the access fails for this vm only.
+             */
+            return mem_cow_page(&vm->as, addr);
+        } else if (!vm_mem_region_is_lazy(vm_config, reg)) {
+            /**
+             * Regions not populated lazily are always fully mapped, except for the page being
+             * moved when the vm is recolored. The access is retried once it is mapped again.
+             */
+            return vm->recolored && !reg->place_phys;
+        }
+
+        /**
+         * Regions are always populated in the same batches, i.e., the batch aligned blocks
+         * clipped to the region. Thus a batch is either fully mapped or not mapped at all.
+         */
+        vaddr_t rgn_end = reg->base + (NUM_PAGES(reg->size) * PAGE_SIZE);
+        vaddr_t batch = ALIGN_FLOOR(addr, VM_MEM_LAZY_BATCH);
+        vaddr_t base = max(batch, (vaddr_t)reg->base);
+        vaddr_t end = min(batch + VM_MEM_LAZY_BATCH, rgn_end);
+
+        /**
+         * The batch might have been populated meanwhile by another of the vm's cpus, in which case
+         * the guest only needs to retry the access. If the pools are exhausted, the access fails.
+         */
+        return DEFINED(MEM_PROT_MMU) &&
+            mem_populate(&vm->as, SEC_VM_ANY, base, NUM_PAGES(end - base), PTE_VM_FLAGS);
+    }
+
+    return false;
+}
+
 static void vm_init_ipc(struct vm* vm, const struct vm_config* vm_config)
 {
     vm->ipc_num = vm_config->platform.ipc_num;
@@ -268,60 +361,140 @@ struct vm* vm_init(struct vm_allocation* vm_alloc, const struct vm_config* vm_co
      * Create the VM's address space according to configuration and where its image was loaded.
      */
     if (master) {
+        uint64_t mem_regions_begin = boot_prof_begin();
         vm_init_mem_regions(vm, vm_config);
+        boot_prof_end(BOOT_PROF_VM_INIT_MEM_REGIONS, mem_regions_begin);
         vm_init_dev(vm, vm_config);
         vm_init_ipc(vm, vm_config);
+        vconsole_init(vm, vm_config);
     }
 
     cpu_sync_and_clear_msgs(&vm->sync);
 
+    /**
+     * If the master set up an image copy, all the vm's cpus take part in it. The master can only
+     * tear down the image mappings after everyone is done.
+     */
+    if (vm->install.size > 0) {
+        vm_install_image_copy(vm);
+        cpu_sync_barrier(&vm->sync);
+        if (master) {
+            vm_install_image_finish(vm);
+        }
+        cpu_sync_and_clear_msgs(&vm->sync);
+    }
+
     return vm;
 }
 
 void vm_emul_add_mem(struct vm* vm, struct emul_mem* emu)
 {
-    list_push(&vm->emul_mem_list, &emu->node);
+    if (vm->emul_mem_num >= VM_EMUL_MEM_MAX) {
+        ERROR("too many memory emulation handlers");
+    }
+
+    size_t i = vm->emul_mem_num;
+    while ((i > 0) && (vm->emul_mem[i - 1]->va_base > emu->va_base)) {
+        vm->emul_mem[i] = vm->emul_mem[i - 1];
+        i--;
+    }
+
+    if (((i > 0) &&
+            range_overlap_range(vm->emul_mem[i - 1]->va_base, vm->emul_mem[i - 1]->size,
+                emu->va_base, emu->size)) ||
+        ((i < vm->emul_mem_num) &&
+            range_overlap_range(vm->emul_mem[i + 1]->va_base, vm->emul_mem[i + 1]->size,
+                emu->va_base, emu->size))) {
+        ERROR("overlapping memory emulation handlers at 0x%lx", emu->va_base);
+    }
+
+    vm->emul_mem[i] = emu;
+    vm->emul_mem_num++;
 }
 
 void vm_emul_add_reg(struct vm* vm, struct emul_reg* emu)
 {
-    list_push(&vm->emul_reg_list, &emu->node);
+    if (vm->emul_reg_num >= VM_EMUL_REG_MAX) {
+        ERROR("too many register emulation handlers");
+    }
+
+    size_t i = vm->emul_reg_num;
+    while ((i > 0) && (vm->emul_reg[i - 1]->addr > emu->addr)) {
+        vm->emul_reg[i] = vm->emul_reg[i - 1];
+        i--;
+    }
+
+    if ((i > 0) && (vm->emul_reg[i - 1]->addr == emu->addr)) {
+        ERROR("duplicate register emulation handler for 0x%lx", emu->addr);
+    }
+
+    vm->emul_reg[i] = emu;
+    vm->emul_reg_num++;
 }
 
 emul_handler_t vm_emul_get_mem(struct vm* vm, vaddr_t addr)
 {
-    emul_handler_t handler = NULL;
-    list_foreach (vm->emul_mem_list, struct emul_mem, emu) {
-        if (addr >= emu->va_base && (addr < (emu->va_base + emu->size))) {
-            handler = emu->handler;
-            break;
+    struct vcpu* vcpu = cpu()->vcpu;
+    struct emul_mem* emu = vcpu->emul_mem_last;
+
+    if ((emu != NULL) && in_range(addr, emu->va_base, emu->size)) {
+        return emu->handler;
+    }
+
+    /* Look for the last handler starting at or below addr */
+    size_t lo = 0;
+    size_t hi = vm->emul_mem_num;
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if (vm->emul_mem[mid]->va_base <= addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if (lo > 0) {
+        emu = vm->emul_mem[lo - 1];
+        if (in_range(addr, emu->va_base, emu->size)) {
+            vcpu->emul_mem_last = emu;
+            return emu->handler;
         }
     }
 
-    return handler;
+    return NULL;
 }
 
 emul_handler_t vm_emul_get_reg(struct vm* vm, vaddr_t addr)
 {
-    emul_handler_t handler = NULL;
-    list_foreach (vm->emul_reg_list, struct emul_reg, emu) {
-        if (emu->addr == addr) {
-            handler = emu->handler;
-            break;
+    struct vcpu* vcpu = cpu()->vcpu;
+    struct emul_reg* emu = vcpu->emul_reg_last;
+
+    if ((emu != NULL) && (emu->addr == addr)) {
+        return emu->handler;
+    }
+
+    size_t lo = 0;
+    size_t hi = vm->emul_reg_num;
+    while (lo < hi) {
+        size_t mid = lo + ((hi - lo) / 2);
+        if (vm->emul_reg[mid]->addr < addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
     }
 
-    return handler;
+    if ((lo < vm->emul_reg_num) && (vm->emul_reg[lo]->addr == addr)) {
+        vcpu->emul_reg_last = vm->emul_reg[lo];
+        return vm->emul_reg[lo]->handler;
+    }
+
+    return NULL;
 }
 
 void vm_msg_broadcast(struct vm* vm, struct cpu_msg* msg)
 {
-    for (size_t i = 0, n = 0; n < vm->cpu_num - 1; i++) {
-        if (((1U << i) & vm->cpus) && (i != cpu()->id)) {
-            n++;
-            cpu_send_msg(i, msg);
-        }
-    }
+    cpu_send_msg_multicast(vm->cpus & ~(1UL << cpu()->id), msg);
 }
 
 __attribute__((weak)) cpumap_t vm_translate_to_pcpu_mask(struct vm* vm, cpumap_t mask, size_t len)
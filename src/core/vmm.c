@@ -11,6 +11,9 @@
 #include <fences.h>
 #include <string.h>
 #include <shmem.h>
+#include <trace.h>
+#include <memguard.h>
+#include <boot_prof.h>
 
 static struct vm_assignment {
     spinlock_t lock;
@@ -128,16 +131,23 @@ void vmm_init()
     vmm_arch_init();
     vmm_io_init();
     shmem_init();
+    trace_init();
+    memguard_init();
 
     cpu_sync_barrier(&cpu_glb_sync);
 
     bool master = false;
     vmid_t vm_id = INVALID_VMID;
-    if (vmm_assign_vcpu(&master, &vm_id)) {
+    uint64_t assign_begin = boot_prof_begin();
+    bool assigned = vmm_assign_vcpu(&master, &vm_id);
+    boot_prof_end(BOOT_PROF_VMM_ASSIGN_VCPU, assign_begin);
+    if (assigned) {
         struct vm_allocation* vm_alloc = vmm_alloc_install_vm(vm_id, master);
         struct vm_config* vm_config = &config.vmlist[vm_id];
         struct vm* vm = vm_init(vm_alloc, vm_config, master, vm_id);
+        memguard_cpu_init(vm_config);
         cpu_sync_barrier(&vm->sync);
+        boot_prof_report(vm);
         vcpu_run(cpu()->vcpu);
     } else {
         cpu_idle();
@@ -5,84 +5,132 @@
 
 #include <bitmap.h>
 
+#define BITMAP_GRANULE_FULL (~((bitmap_granule_t)0))
+
+/**
+ * Returns the granule at index idx such that the bits with the value we are looking for are set.
+ */
+static inline bitmap_granule_t bitmap_granule(bitmap_t* map, size_t idx, bool set)
+{
+    return set ? map[idx] : ~map[idx];
+}
+
+/**
+ * Returns the mask of the granule at index idx bits which are below size.
+ */
+static inline bitmap_granule_t bitmap_granule_size_mask(size_t size, size_t idx)
+{
+    size_t valid_bits = size - (idx * BITMAP_GRANULE_LEN);
+    return (valid_bits >= BITMAP_GRANULE_LEN) ? BITMAP_GRANULE_FULL :
+                                                BITMAP_GRANULE_MASK(0, valid_bits);
+}
+
+ssize_t bitmap_find_next(bitmap_t* map, size_t size, size_t start, bool set)
+{
+    if (start >= size) {
+        return -1;
+    }
+
+    size_t idx = start / BITMAP_GRANULE_LEN;
+    size_t last_idx = (size - 1) / BITMAP_GRANULE_LEN;
+    bitmap_granule_t word =
+        bitmap_granule(map, idx, set) & (BITMAP_GRANULE_FULL << (start % BITMAP_GRANULE_LEN));
+
+    while (word == 0) {
+        if (++idx > last_idx) {
+            return -1;
+        }
+        word = bitmap_granule(map, idx, set);
+    }
+
+    size_t pos = (idx * BITMAP_GRANULE_LEN) + bit32_ctz(word);
+    return (pos < size) ? (ssize_t)pos : -1;
+}
+
 ssize_t bitmap_find_nth(bitmap_t* map, size_t size, size_t nth, size_t start, bool set)
 {
-    if (size <= 0 || nth <= 0) {
+    if (size <= 0 || nth <= 0 || start >= size) {
         return -1;
     }
 
-    size_t count = 0;
-    unsigned bit = set ? 1 : 0;
+    if (nth == 1) {
+        return bitmap_find_next(map, size, start, set);
+    }
+
+    size_t idx = start / BITMAP_GRANULE_LEN;
+    size_t last_idx = (size - 1) / BITMAP_GRANULE_LEN;
+    bitmap_granule_t word =
+        bitmap_granule(map, idx, set) & (BITMAP_GRANULE_FULL << (start % BITMAP_GRANULE_LEN));
+
+    while (true) {
+        if (idx == last_idx) {
+            word &= bitmap_granule_size_mask(size, idx);
+        }
 
-    for (size_t i = start; i < size; i++) {
-        if (bitmap_get(map, i) == bit) {
-            if (++count == nth) {
-                return (ssize_t)i;
+        size_t count = bit32_popcount(word);
+        if (count >= nth) {
+            /* Drop the nth - 1 least significant candidates */
+            while (--nth > 0) {
+                word &= word - 1;
             }
+            return (ssize_t)((idx * BITMAP_GRANULE_LEN) + bit32_ctz(word));
         }
-    }
 
-    return -1;
+        nth -= count;
+        if (++idx > last_idx) {
+            return -1;
+        }
+        word = bitmap_granule(map, idx, set);
+    }
 }
 
 size_t bitmap_count_consecutive(bitmap_t* map, size_t size, size_t start, size_t n)
 {
-    size_t pos = start;
-    size_t count = 0;
-    size_t start_offset = start % BITMAP_GRANULE_LEN;
-    size_t first_word_bits = min(BITMAP_GRANULE_LEN - start_offset, n);
-    bool set = !!bitmap_get(map, start);
-    bitmap_granule_t init_mask = BITMAP_GRANULE_MASK(start_offset, first_word_bits);
-    bitmap_granule_t mask;
-
     if (n <= 1) {
         return n;
     }
 
-    mask = set ? init_mask : ~init_mask;
-    if (!((map[pos / BITMAP_GRANULE_LEN] ^ mask) & init_mask)) {
-        count += first_word_bits;
-        pos += first_word_bits;
+    if (start >= size) {
+        return 0;
     }
 
-    mask = set ? ~0U : 0U;
-    while ((pos < size) && !(map[pos / BITMAP_GRANULE_LEN] ^ mask) && (count < n)) {
-        count += BITMAP_GRANULE_LEN;
-        pos += BITMAP_GRANULE_LEN;
-    }
+    bool set = !!bitmap_get(map, start);
+    size_t limit = min(n, size - start);
+    size_t pos = start;
+    size_t count = 0;
+
+    while (count < limit) {
+        size_t offset = pos % BITMAP_GRANULE_LEN;
+        size_t avail = BITMAP_GRANULE_LEN - offset;
+        /* After the shift, the run we are counting are the granule's trailing ones */
+        bitmap_granule_t word = bitmap_granule(map, pos / BITMAP_GRANULE_LEN, set) >> offset;
+        size_t run = (word == BITMAP_GRANULE_FULL) ? BITMAP_GRANULE_LEN : bit32_ctz(~word);
 
-    while ((pos < size) && (!!bitmap_get(map, pos) == set) && (count < n)) {
-        count++;
-        pos += 1;
+        count += run;
+        pos += run;
+        if (run < avail) {
+            break;
+        }
     }
 
-    return count;
+    return min(count, limit);
 }
 
 ssize_t bitmap_find_consec(bitmap_t* map, size_t size, size_t start, size_t n, bool set)
 {
-    ssize_t count = 0;
-    ssize_t i = 0;
+    ssize_t i = bitmap_find_next(map, size, start, set);
 
-    // find first set
-    if ((i = bitmap_find_nth(map, size, 1, start, set)) < 0) {
-        return -1;
+    if (n <= 1) {
+        return i;
     }
 
-    while (i < (ssize_t)size) {
-        // find the last (with n as maximum) contiguous set page
-        count = (ssize_t)bitmap_count_consecutive(map, size, (size_t)i, n);
-        if (count < (ssize_t)n) { // if didn't found enough n contiguous set pages
-            i += count;
-            // find the last contiguous ~set page
-            i += (ssize_t)bitmap_count_consecutive(map, size, (size_t)i, SIZE_MAX);
-        } else {
+    while (i >= 0) {
+        size_t count = bitmap_count_consecutive(map, size, (size_t)i, n);
+        if (count >= n) {
             break;
         }
-    }
-
-    if (i >= (ssize_t)size) {
-        i = -1;
+        /* The bit right after the run has the opposite value, or is beyond size */
+        i = bitmap_find_next(map, size, (size_t)i + count + 1, set);
     }
 
     return i;
@@ -90,6 +138,10 @@ ssize_t bitmap_find_consec(bitmap_t* map, size_t size, size_t start, size_t n, b
 
 void bitmap_set_consecutive(bitmap_t* map, size_t start, size_t n)
 {
+    if (n == 0) {
+        return;
+    }
+
     size_t pos = start;
     size_t count = n;
     size_t start_offset = start % BITMAP_GRANULE_LEN;
@@ -100,7 +152,7 @@ void bitmap_set_consecutive(bitmap_t* map, size_t start, size_t n)
     count -= first_word_bits;
 
     while (count >= BITMAP_GRANULE_LEN) {
-        map[pos / BITMAP_GRANULE_LEN] |= ~((bitmap_granule_t)0);
+        map[pos / BITMAP_GRANULE_LEN] |= BITMAP_GRANULE_FULL;
         pos += BITMAP_GRANULE_LEN;
         count -= BITMAP_GRANULE_LEN;
     }
@@ -109,3 +161,51 @@ void bitmap_set_consecutive(bitmap_t* map, size_t start, size_t n)
         map[pos / BITMAP_GRANULE_LEN] |= BITMAP_GRANULE_MASK(0, count);
     }
 }
+
+void bitmap_clear_consecutive(bitmap_t* map, size_t start, size_t n)
+{
+    if (n == 0) {
+        return;
+    }
+
+    size_t pos = start;
+    size_t count = n;
+    size_t start_offset = start % BITMAP_GRANULE_LEN;
+    size_t first_word_bits = min(BITMAP_GRANULE_LEN - start_offset, count);
+
+    map[pos / BITMAP_GRANULE_LEN] &= ~BITMAP_GRANULE_MASK(start_offset, first_word_bits);
+    pos += first_word_bits;
+    count -= first_word_bits;
+
+    while (count >= BITMAP_GRANULE_LEN) {
+        map[pos / BITMAP_GRANULE_LEN] = 0;
+        pos += BITMAP_GRANULE_LEN;
+        count -= BITMAP_GRANULE_LEN;
+    }
+
+    if (count > 0) {
+        map[pos / BITMAP_GRANULE_LEN] &= ~BITMAP_GRANULE_MASK(0, count);
+    }
+}
+
+size_t bitmap_count(bitmap_t* map, size_t start, size_t end, bool set)
+{
+    size_t count = 0;
+
+    if (start >= end) {
+        return 0;
+    }
+
+    size_t idx = start / BITMAP_GRANULE_LEN;
+    size_t last_idx = (end - 1) / BITMAP_GRANULE_LEN;
+    bitmap_granule_t word =
+        bitmap_granule(map, idx, set) & (BITMAP_GRANULE_FULL << (start % BITMAP_GRANULE_LEN));
+
+    while (idx < last_idx) {
+        count += bit32_popcount(word);
+        word = bitmap_granule(map, ++idx, set);
+    }
+    count += bit32_popcount(word & bitmap_granule_size_mask(end, idx));
+
+    return count;
+}
@@ -0,0 +1,68 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __ATOMIC_H__
+#define __ATOMIC_H__
+
+#include <bao.h>
+
+/**
+ * Thin wrappers around the compiler's atomic builtins for machine word sized values. Only word
+ * sized operations are provided so that they are always inlined as native exclusive/atomic
+ * instruction sequences, never as calls to libatomic (which we don't link against).
+ */
+
+static inline unsigned long atomic_load_relaxed(volatile unsigned long* ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_RELAXED);
+}
+
+static inline unsigned long atomic_load_acquire(volatile unsigned long* ptr)
+{
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomic_store_relaxed(volatile unsigned long* ptr, unsigned long val)
+{
+    __atomic_store_n(ptr, val, __ATOMIC_RELAXED);
+}
+
+static inline void atomic_store_release(volatile unsigned long* ptr, unsigned long val)
+{
+    __atomic_store_n(ptr, val, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Compare-and-swap. If *ptr equals *expected, writes desired to *ptr and returns true.
+ *        Otherwise, updates *expected with the current value of *ptr and returns false.
+ */
+static inline bool atomic_cas(volatile unsigned long* ptr, unsigned long* expected,
+    unsigned long desired)
+{
+    return __atomic_compare_exchange_n(ptr, expected, desired, false, __ATOMIC_ACQ_REL,
+        __ATOMIC_RELAXED);
+}
+
+static inline unsigned long atomic_fetch_add(volatile unsigned long* ptr, unsigned long val)
+{
+    return __atomic_fetch_add(ptr, val, __ATOMIC_ACQ_REL);
+}
+
+static inline unsigned long atomic_fetch_or(volatile unsigned long* ptr, unsigned long val)
+{
+    return __atomic_fetch_or(ptr, val, __ATOMIC_ACQ_REL);
+}
+
+static inline unsigned long atomic_fetch_and(volatile unsigned long* ptr, unsigned long val)
+{
+    return __atomic_fetch_and(ptr, val, __ATOMIC_ACQ_REL);
+}
+
+static inline unsigned long atomic_exchange(volatile unsigned long* ptr, unsigned long val)
+{
+    return __atomic_exchange_n(ptr, val, __ATOMIC_ACQ_REL);
+}
+
+#endif /* __ATOMIC_H__ */
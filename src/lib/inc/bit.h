@@ -71,6 +71,37 @@ BIT_OPS_GEN(bit32, uint32_t, UINT32_C(1), BIT32_MASK)
 BIT_OPS_GEN(bit64, uint64_t, UINT64_C(1), BIT64_MASK)
 BIT_OPS_GEN(bit, unsigned long, (1UL), BIT_MASK)
 
+/**
+ * Constant time bit scan and population count for 32-bit words. We only use the compiler builtins
+ * when the target has native instructions for them, as otherwise the compiler emits calls to
+ * libgcc helpers, which we do not link against. Arm has clz (and rbit) in its base ISA, while
+ * RISC-V only has them with Zbb. No target has a general purpose register popcount instruction
+ * in the base ISAs we build for, so we always use the parallel bit count.
+ */
+#if !defined(__riscv) || defined(__riscv_zbb)
+#define BIT_NATIVE_SCAN
+#endif
+
+/* Index of the least significant set bit. Undefined for 0. */
+static inline size_t bit32_ctz(uint32_t word)
+{
+#ifdef BIT_NATIVE_SCAN
+    return (size_t)__builtin_ctz(word);
+#else
+    static const uint8_t debruijn_idx[32] = { 0, 1, 28, 2, 29, 14, 24, 3, 30, 22, 20, 15, 25, 17,
+        4, 8, 31, 27, 13, 23, 21, 19, 16, 7, 26, 12, 18, 6, 11, 5, 10, 9 };
+    return debruijn_idx[((word & -word) * UINT32_C(0x077CB531)) >> 27];
+#endif
+}
+
+static inline size_t bit32_popcount(uint32_t word)
+{
+    word = word - ((word >> 1) & UINT32_C(0x55555555));
+    word = (word & UINT32_C(0x33333333)) + ((word >> 2) & UINT32_C(0x33333333));
+    word = (word + (word >> 4)) & UINT32_C(0x0F0F0F0F);
+    return (size_t)((word * UINT32_C(0x01010101)) >> 24);
+}
+
 #endif /* |__ASSEMBLER__ */
 
 #endif /* __BIT_H__ */
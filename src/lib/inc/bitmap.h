@@ -9,8 +9,6 @@
 #include <bao.h>
 #include <bit.h>
 
-/* TODO: needs optimizations */
-
 typedef uint32_t bitmap_granule_t;
 typedef bitmap_granule_t bitmap_t;
 
@@ -41,30 +39,53 @@ static inline unsigned bitmap_get(bitmap_t* map, size_t bit)
 }
 
 void bitmap_set_consecutive(bitmap_t* map, size_t start, size_t n);
+void bitmap_clear_consecutive(bitmap_t* map, size_t start, size_t n);
 
-static inline void bitmap_clear_consecutive(bitmap_t* map, size_t start, size_t n)
-{
-    for (size_t i = 0; i < n; i++) {
-        bitmap_clear(map, start + i);
-    }
-}
+/**
+ * @brief Counts the bits in [start, end) with the given value.
+ */
+size_t bitmap_count(bitmap_t* map, size_t start, size_t end, bool set);
 
-static inline size_t bitmap_count(bitmap_t* map, size_t start, size_t n, bool set)
-{
-    size_t count = 0;
-    for (size_t i = start; i < n; i++) {
-        if (bitmap_get(map, i) == set) {
-            count++;
-        }
-    }
-
-    return count;
-}
+/**
+ * All search functions below operate a granule at a time, skipping granules with no candidate
+ * bits and locating bits within a granule using bit scan instructions.
+ */
 
 ssize_t bitmap_find_nth(bitmap_t* map, size_t size, size_t nth, size_t start, bool set);
 
+/**
+ * @brief Finds the first bit at or after start with the given value.
+ *
+ * @return the bit index or -1 if there is none before size
+ */
+ssize_t bitmap_find_next(bitmap_t* map, size_t size, size_t start, bool set);
+
+/**
+ * @brief Counts how many bits, starting at start and up to a maximum of n, have the same value as
+ *        the one at start.
+ */
 size_t bitmap_count_consecutive(bitmap_t* map, size_t size, size_t start, size_t n);
 
+/**
+ * @brief Finds the first run of n consecutive bits with the given value at or after start.
+ *
+ * @return the index of the first bit of the run or -1 if there is none
+ */
 ssize_t bitmap_find_consec(bitmap_t* map, size_t size, size_t start, size_t n, bool set);
 
+static inline ssize_t bitmap_find_next_set(bitmap_t* map, size_t size, size_t start)
+{
+    return bitmap_find_next(map, size, start, true);
+}
+
+static inline ssize_t bitmap_find_next_clear(bitmap_t* map, size_t size, size_t start)
+{
+    return bitmap_find_next(map, size, start, false);
+}
+
+static inline ssize_t bitmap_find_clear_range(bitmap_t* map, size_t size, size_t start, size_t n)
+{
+    return bitmap_find_consec(map, size, start, n, false);
+}
+
 #endif /* __BITMAP_H__ */
@@ -5,6 +5,11 @@
 
 #include <string.h>
 
+/**
+ * Generic implementations, used unless the architecture provides optimized ones.
+ */
+#ifndef ARCH_STRING
+
 void* memcpy(void* dst, const void* src, size_t count)
 {
     size_t i;
@@ -49,6 +54,8 @@ void* memset(void* dest, int c, size_t count)
     return dest;
 }
 
+#endif /* ARCH_STRING */
+
 char* strcat(char* dest, char* src)
 {
     char* save = dest;
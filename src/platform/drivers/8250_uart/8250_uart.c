@@ -40,3 +40,23 @@ void uart_putc(volatile struct uart8250_hw* uart, int8_t c)
     while (!(uart->lsr & UART8250_LSR_THRE)) { }
     uart->thr = (uart8250_reg_t)c;
 }
+
+bool uart_tx_ready(volatile struct uart8250_hw* uart)
+{
+    return (uart->lsr & UART8250_LSR_THRE) != 0;
+}
+
+void uart_tx_irq_enable(volatile struct uart8250_hw* uart, bool en)
+{
+    if (en) {
+        uart->ier |= UART8250_IER_ETBEI;
+    } else {
+        uart->ier &= (uart8250_reg_t)~UART8250_IER_ETBEI;
+    }
+}
+
+void uart_clear_irqs(volatile struct uart8250_hw* uart)
+{
+    /* reading the iir acknowledges the transmitter holding register empty interrupt */
+    (void)uart->iir;
+}
@@ -62,10 +62,15 @@ struct uart8250_hw {
 #define UART8250_FCR_RX_CLR (0x1 << 1)
 #define UART8250_FCR_EN     (0x1 << 0)
 
+#define UART8250_IER_ETBEI  (0x1 << 1)
+
 typedef struct uart8250_hw bao_uart_t;
 
 void uart_enable(volatile struct uart8250_hw* uart);
 void uart_init(volatile struct uart8250_hw* uart);
 void uart_putc(volatile struct uart8250_hw* uart, int8_t c);
+bool uart_tx_ready(volatile struct uart8250_hw* uart);
+void uart_tx_irq_enable(volatile struct uart8250_hw* uart, bool en);
+void uart_clear_irqs(volatile struct uart8250_hw* uart);
 
 #endif /* UART8250_H */
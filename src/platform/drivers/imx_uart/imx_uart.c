@@ -6,8 +6,8 @@
 #include <drivers/imx_uart.h>
 #include <fences.h>
 
-#define IMX_UART_STAT2_TXDC   (1 << 3)
 #define IMX_UART_STAT2_TXFULL (1 << 4)
+#define IMX_UART_CR1_TRDYEN   (1U << 13)
 
 void uart_init(volatile struct imx_uart* uart)
 {
@@ -25,7 +25,26 @@ void uart_putc(volatile struct imx_uart* uart, int8_t c)
 {
     while (uart->ts & IMX_UART_STAT2_TXFULL) { }
     uart->txd = (uint32_t)c;
-    while (!(uart->stat2 & IMX_UART_STAT2_TXDC)) { }
+}
+
+bool uart_tx_ready(volatile struct imx_uart* uart)
+{
+    return !(uart->ts & IMX_UART_STAT2_TXFULL);
+}
+
+void uart_tx_irq_enable(volatile struct imx_uart* uart, bool en)
+{
+    if (en) {
+        uart->cr1 |= IMX_UART_CR1_TRDYEN;
+    } else {
+        uart->cr1 &= ~IMX_UART_CR1_TRDYEN;
+    }
+}
+
+void uart_clear_irqs(volatile struct imx_uart* uart)
+{
+    /* the transmitter ready interrupt is level triggered and cleared by filling the fifo */
+    UNUSED_ARG(uart);
 }
 
 void uart_puts(volatile struct imx_uart* uart, int8_t const* str)
@@ -7,6 +7,7 @@
 #define IMX_UART_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 struct imx_uart {
     uint32_t rxd;            /* 0x0 */
@@ -35,5 +36,8 @@ void uart_enable(volatile struct imx_uart* uart);
 void uart_init(volatile struct imx_uart* uart);
 void uart_puts(volatile struct imx_uart* uart, const int8_t* str);
 void uart_putc(volatile struct imx_uart* uart, int8_t str);
+bool uart_tx_ready(volatile struct imx_uart* uart);
+void uart_tx_irq_enable(volatile struct imx_uart* uart, bool en);
+void uart_clear_irqs(volatile struct imx_uart* uart);
 
 #endif /* IMX_UART_H */
@@ -27,6 +27,7 @@ struct lpuart {
 #define LPUART_GLOBAL_RST_BIT    (1U << 1)
 #define LPUART_BAUD_80MHZ_115200 ((4 << 24) | (1 << 17) | 138)
 #define LPUART_CTRL_TE_BIT       (1U << 19)
+#define LPUART_CTRL_TIE_BIT      (1U << 23)
 #define LPUART_STAT_TDRE_BIT     (1U << 23)
 
 typedef struct lpuart bao_uart_t;
@@ -34,4 +35,7 @@ typedef struct lpuart bao_uart_t;
 void uart_enable(volatile struct lpuart* uart);
 void uart_init(volatile struct lpuart* uart);
 void uart_putc(volatile struct lpuart* uart, int8_t c);
+bool uart_tx_ready(volatile struct lpuart* uart);
+void uart_tx_irq_enable(volatile struct lpuart* uart, bool en);
+void uart_clear_irqs(volatile struct lpuart* uart);
 #endif /* __UART_NXP_H */
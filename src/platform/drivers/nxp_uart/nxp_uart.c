@@ -4,6 +4,7 @@
  */
 
 #include <drivers/nxp_uart.h>
+#include <bao.h>
 
 void uart_init(volatile struct lpuart* uart)
 {
@@ -23,3 +24,22 @@ void uart_putc(volatile struct lpuart* uart, int8_t c)
     while (!(uart->stat & LPUART_STAT_TDRE_BIT)) { }
     uart->data = (uint32_t)c;
 }
+
+bool uart_tx_ready(volatile struct lpuart* uart)
+{
+    return (uart->stat & LPUART_STAT_TDRE_BIT) != 0;
+}
+
+void uart_tx_irq_enable(volatile struct lpuart* uart, bool en)
+{
+    if (en) {
+        uart->ctrl |= LPUART_CTRL_TIE_BIT;
+    } else {
+        uart->ctrl &= ~LPUART_CTRL_TIE_BIT;
+    }
+}
+
+void uart_clear_irqs(volatile struct lpuart* uart)
+{
+    UNUSED_ARG(uart);
+}
@@ -98,3 +98,22 @@ void uart_putc(volatile struct Pl011_Uart_hw* ptr_uart, int8_t c)
 
     ptr_uart->data = (uint32_t)c;
 }
+
+bool uart_tx_ready(volatile struct Pl011_Uart_hw* ptr_uart)
+{
+    return !(ptr_uart->flag & UART_FR_TXFF);
+}
+
+void uart_tx_irq_enable(volatile struct Pl011_Uart_hw* ptr_uart, bool en)
+{
+    if (en) {
+        ptr_uart->isr_mask |= UART_IMSC_TXIM;
+    } else {
+        ptr_uart->isr_mask &= ~UART_IMSC_TXIM;
+    }
+}
+
+void uart_clear_irqs(volatile struct Pl011_Uart_hw* ptr_uart)
+{
+    ptr_uart->isr_clear = ptr_uart->masked_isr_status;
+}
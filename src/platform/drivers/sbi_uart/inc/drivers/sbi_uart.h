@@ -13,5 +13,8 @@ typedef volatile uint8_t bao_uart_t;
 bool uart_init(bao_uart_t* uart);
 void uart_enable(bao_uart_t* uart);
 void uart_putc(bao_uart_t* uart, const int8_t c);
+bool uart_tx_ready(bao_uart_t* uart);
+void uart_tx_irq_enable(bao_uart_t* uart, bool en);
+void uart_clear_irqs(bao_uart_t* uart);
 
 #endif /* __SBI_UART_H__ */
@@ -23,3 +23,21 @@ void uart_putc(bao_uart_t* uart, const int8_t c)
 
     sbi_console_putchar(c);
 }
+
+bool uart_tx_ready(bao_uart_t* uart)
+{
+    UNUSED_ARG(uart);
+
+    return true;
+}
+
+void uart_tx_irq_enable(bao_uart_t* uart, bool en)
+{
+    UNUSED_ARG(uart);
+    UNUSED_ARG(en);
+}
+
+void uart_clear_irqs(bao_uart_t* uart)
+{
+    UNUSED_ARG(uart);
+}
@@ -314,5 +314,8 @@ void uart_disable(volatile struct Uart_Zynq_hw* uart);
 bool uart_set_baud_rate(volatile struct Uart_Zynq_hw* uart, uint32_t baud_rate);
 uint32_t uart_getc(volatile struct Uart_Zynq_hw* uart);
 void uart_putc(volatile struct Uart_Zynq_hw* uart, int8_t c);
+bool uart_tx_ready(volatile struct Uart_Zynq_hw* uart);
+void uart_tx_irq_enable(volatile struct Uart_Zynq_hw* uart, bool en);
+void uart_clear_irqs(volatile struct Uart_Zynq_hw* uart);
 
 #endif /* __UART_ZYNQ_H */
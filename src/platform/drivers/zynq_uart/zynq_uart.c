@@ -107,3 +107,22 @@ void uart_putc(volatile struct Uart_Zynq_hw* uart, int8_t c)
 
     uart->tx_rx_fifo = (uint32_t)c;
 }
+
+bool uart_tx_ready(volatile struct Uart_Zynq_hw* uart)
+{
+    return !(uart->ch_status & UART_CH_STATUS_TFUL);
+}
+
+void uart_tx_irq_enable(volatile struct Uart_Zynq_hw* uart, bool en)
+{
+    if (en) {
+        uart->isr_en = UART_ISR_EN_TEMPTY;
+    } else {
+        uart->isr_dis = UART_ISR_DIS_TEMPTY;
+    }
+}
+
+void uart_clear_irqs(volatile struct Uart_Zynq_hw* uart)
+{
+    uart->isr_status = uart->isr_status;
+}
@@ -19,6 +19,7 @@ struct platform platform = {
 
     .console = {
         .base = 0x1C090000,  // UART0 (PL011)
+        .irq_id = 37,
     },
 
     .arch = {
@@ -44,5 +44,6 @@ struct platform platform = {
 
     .console = {
         .base = 0xFFF32000, /* UART 6 */
+        .irq_id = 111,
     },
 };
@@ -17,6 +17,7 @@ struct platform platform = {
 
     .console = {
         .base = 0x30880000,
+        .irq_id = 60,
     },
 
     .arch = {
@@ -21,6 +21,7 @@ struct platform platform = {
 
     .console = {
         .base = 0x5a060000,
+        .irq_id = 377,
     },
 
     .arch = {
@@ -17,7 +17,8 @@ struct platform platform = {
     },
 
     .console = {
-        .base = 0x9000000
+        .base = 0x9000000,
+        .irq_id = 33,
     },
 
     .arch = {
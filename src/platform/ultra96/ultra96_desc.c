@@ -21,6 +21,7 @@ struct platform platform = {
 
     .console = {
         .base = 0xFF010000,
+        .irq_id = 54,
     },
 
     .arch = {
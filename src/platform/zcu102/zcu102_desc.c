@@ -33,6 +33,7 @@ struct platform platform = {
 
     .console = {
         .base = 0xFF000000,
+        .irq_id = 53,
     },
 
     .arch = {
@@ -29,6 +29,7 @@ struct platform platform = {
 
     .console = {
         .base = 0xFF000000,
+        .irq_id = 53,
     },
 
     .arch = {
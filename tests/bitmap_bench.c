@@ -0,0 +1,136 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <test.h>
+#include <bitmap.h>
+
+/**
+ * Times the bitmap searches used by the page allocator on a map the size of a 1 GiB page pool,
+ * at several allocation densities, against bit by bit searches like the ones they replaced.
+ */
+
+#define MAP_BITS  (256UL * 1024)
+#define BENCH_OPS (2000)
+
+static BITMAP_ALLOC(map, MAP_BITS);
+
+static ssize_t naive_find_next(size_t size, size_t start, bool set)
+{
+    for (size_t i = start; i < size; i++) {
+        if ((bitmap_get(map, i) != 0) == set) {
+            return (ssize_t)i;
+        }
+    }
+    return -1;
+}
+
+static ssize_t naive_find_consec(size_t size, size_t start, size_t n, bool set)
+{
+    size_t run = 0;
+    for (size_t i = start; i < size; i++) {
+        run = ((bitmap_get(map, i) != 0) == set) ? (run + 1) : 0;
+        if (run == n) {
+            return (ssize_t)(i + 1 - n);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Fills the map so that a fraction of density percent of the pages is allocated, in runs of
+ * random length, as a fragmented page pool would be.
+ */
+static void fill_map(unsigned density)
+{
+    size_t i = 0;
+    while (i < MAP_BITS) {
+        size_t run = 1 + test_rand_below(64);
+        bool set = test_rand_below(100) < density;
+        run = min(run, MAP_BITS - i);
+        if (set) {
+            bitmap_set_consecutive(map, i, run);
+        } else {
+            bitmap_clear_consecutive(map, i, run);
+        }
+        i += run;
+    }
+}
+
+static size_t starts[BENCH_OPS];
+
+static void report(const char* name, unsigned density, uint64_t fast_ns, uint64_t naive_ns)
+{
+    printf("%-24s %3u%%  %10.1f ns/op  %10.1f ns/op naive  %6.1fx\n", name, density,
+        (double)fast_ns / BENCH_OPS, (double)naive_ns / BENCH_OPS,
+        (double)naive_ns / (double)(fast_ns ? fast_ns : 1));
+}
+
+static void bench_density(unsigned density)
+{
+    uint64_t begin, fast_ns, naive_ns;
+    uint64_t sum = 0;
+
+    fill_map(density);
+    for (size_t i = 0; i < BENCH_OPS; i++) {
+        starts[i] = test_rand_below(MAP_BITS);
+    }
+
+    begin = bench_now_ns();
+    for (size_t i = 0; i < BENCH_OPS; i++) {
+        sum += (uint64_t)bitmap_find_next(map, MAP_BITS, starts[i], false);
+    }
+    fast_ns = bench_now_ns() - begin;
+    begin = bench_now_ns();
+    for (size_t i = 0; i < BENCH_OPS; i++) {
+        sum += (uint64_t)naive_find_next(MAP_BITS, starts[i], false);
+    }
+    naive_ns = bench_now_ns() - begin;
+    report("find_next_clear", density, fast_ns, naive_ns);
+
+    size_t lens[] = { 8, 64, 512 };
+    for (size_t k = 0; k < (sizeof(lens) / sizeof(lens[0])); k++) {
+        begin = bench_now_ns();
+        for (size_t i = 0; i < BENCH_OPS; i++) {
+            sum += (uint64_t)bitmap_find_clear_range(map, MAP_BITS, starts[i], lens[k]);
+        }
+        fast_ns = bench_now_ns() - begin;
+        begin = bench_now_ns();
+        for (size_t i = 0; i < BENCH_OPS; i++) {
+            sum += (uint64_t)naive_find_consec(MAP_BITS, starts[i], lens[k], false);
+        }
+        naive_ns = bench_now_ns() - begin;
+        char name[32];
+        snprintf(name, sizeof(name), "find_clear_range %zu", lens[k]);
+        report(name, density, fast_ns, naive_ns);
+    }
+
+    begin = bench_now_ns();
+    for (size_t i = 0; i < BENCH_OPS; i++) {
+        sum += bitmap_count(map, 0, MAP_BITS - starts[i], true);
+    }
+    fast_ns = bench_now_ns() - begin;
+    begin = bench_now_ns();
+    for (size_t i = 0; i < BENCH_OPS; i++) {
+        for (size_t j = 0; j < (MAP_BITS - starts[i]); j++) {
+            sum += bitmap_get(map, j);
+        }
+    }
+    naive_ns = bench_now_ns() - begin;
+    report("count", density, fast_ns, naive_ns);
+
+    bench_sink += sum;
+}
+
+int main(void)
+{
+    unsigned densities[] = { 10, 50, 90, 99 };
+
+    printf("bitmap of %lu bits, %d searches from random starts\n", MAP_BITS, BENCH_OPS);
+    for (size_t i = 0; i < (sizeof(densities) / sizeof(densities[0])); i++) {
+        bench_density(densities[i]);
+    }
+
+    return EXIT_SUCCESS;
+}
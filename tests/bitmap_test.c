@@ -0,0 +1,180 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <test.h>
+#include <bitmap.h>
+
+/**
+ * Checks the granule at a time bitmap search functions against naive bit by bit references, on
+ * random maps of sizes around the granule boundaries and of several densities. The bits of the
+ * last granule beyond the map size are filled with garbage, which must always be ignored.
+ */
+
+#define MAX_BITS (1100)
+
+static const size_t sizes[] = { 1, 2, 31, 32, 33, 63, 64, 65, 95, 96, 97, 128, 257, 1000, 1088 };
+static const unsigned densities[] = { 0, 3, 50, 97, 100 };
+static const size_t consec_lens[] = { 0, 1, 2, 3, 5, 8, 31, 32, 33, 64, 100 };
+
+static BITMAP_ALLOC(map, MAX_BITS);
+static BITMAP_ALLOC(ref, MAX_BITS);
+
+static void fill_map(size_t size, unsigned density)
+{
+    for (size_t i = 0; i < BITMAP_SIZE(MAX_BITS) * BITMAP_GRANULE_LEN; i++) {
+        bool set = (i < size) ? (test_rand_below(100) < density) : (test_rand() & 1);
+        if (set) {
+            bitmap_set(map, i);
+        } else {
+            bitmap_clear(map, i);
+        }
+    }
+}
+
+static ssize_t ref_find_nth(size_t size, size_t nth, size_t start, bool set)
+{
+    if ((nth == 0) || (start >= size)) {
+        return -1;
+    }
+    for (size_t i = start; i < size; i++) {
+        if ((bitmap_get(map, i) != 0) == set) {
+            if (--nth == 0) {
+                return (ssize_t)i;
+            }
+        }
+    }
+    return -1;
+}
+
+static size_t ref_count_consecutive(size_t size, size_t start, size_t n)
+{
+    if (n <= 1) {
+        return n;
+    }
+    if (start >= size) {
+        return 0;
+    }
+    size_t count = 0;
+    while ((count < n) && ((start + count) < size) &&
+        (bitmap_get(map, start + count) == bitmap_get(map, start))) {
+        count++;
+    }
+    return count;
+}
+
+static ssize_t ref_find_consec(size_t size, size_t start, size_t n, bool set)
+{
+    if (n <= 1) {
+        return ref_find_nth(size, 1, start, set);
+    }
+    for (size_t i = start; (i + n) <= size; i++) {
+        size_t j = 0;
+        while ((j < n) && ((bitmap_get(map, i + j) != 0) == set)) {
+            j++;
+        }
+        if (j == n) {
+            return (ssize_t)i;
+        }
+    }
+    return -1;
+}
+
+static size_t ref_count(size_t start, size_t end, bool set)
+{
+    size_t count = 0;
+    for (size_t i = start; i < end; i++) {
+        count += ((bitmap_get(map, i) != 0) == set) ? 1 : 0;
+    }
+    return count;
+}
+
+static void test_search(size_t size)
+{
+    /* Large maps are only checked from a random sample of start positions */
+    size_t max_step = (size > 130) ? 16 : 1;
+    for (size_t start = 0; start < (size + 2); start += 1 + test_rand_below(max_step)) {
+        for (int set = 0; set <= 1; set++) {
+            ssize_t got = bitmap_find_next(map, size, start, set);
+            ssize_t exp = ref_find_nth(size, 1, start, set);
+            CHECK(got == exp, "find_next size %zu start %zu set %d: %zd vs %zd", size, start, set,
+                got, exp);
+
+            for (size_t nth = 0; nth <= 6; nth++) {
+                got = bitmap_find_nth(map, size, nth, start, set);
+                exp = ref_find_nth(size, nth, start, set);
+                CHECK(got == exp, "find_nth size %zu nth %zu start %zu set %d: %zd vs %zd", size,
+                    nth, start, set, got, exp);
+            }
+
+            for (size_t k = 0; k < (sizeof(consec_lens) / sizeof(consec_lens[0])); k++) {
+                size_t n = consec_lens[k];
+                got = bitmap_find_consec(map, size, start, n, set);
+                exp = ref_find_consec(size, start, n, set);
+                CHECK(got == exp, "find_consec size %zu start %zu n %zu set %d: %zd vs %zd", size,
+                    start, n, set, got, exp);
+            }
+        }
+
+        for (size_t k = 0; k < (sizeof(consec_lens) / sizeof(consec_lens[0])); k++) {
+            size_t n = consec_lens[k];
+            size_t got = bitmap_count_consecutive(map, size, start, n);
+            size_t exp = ref_count_consecutive(size, start, n);
+            CHECK(got == exp, "count_consecutive size %zu start %zu n %zu: %zu vs %zu", size,
+                start, n, got, exp);
+        }
+    }
+
+    for (size_t i = 0; i < 200; i++) {
+        size_t start = test_rand_below(size + 1);
+        size_t end = start + test_rand_below(size - start + 1);
+        for (int set = 0; set <= 1; set++) {
+            size_t got = bitmap_count(map, start, end, set);
+            size_t exp = ref_count(start, end, set);
+            CHECK(got == exp, "count [%zu, %zu) set %d: %zu vs %zu", start, end, set, got, exp);
+        }
+    }
+}
+
+static void test_set_clear(void)
+{
+    for (size_t i = 0; i < 5000; i++) {
+        fill_map(MAX_BITS, 50);
+        for (size_t j = 0; j < BITMAP_SIZE(MAX_BITS); j++) {
+            ref[j] = map[j];
+        }
+
+        size_t start = test_rand_below(MAX_BITS);
+        size_t n = test_rand_below(((i % 4) == 0) ? (MAX_BITS - start + 1) : 70);
+        n = min(n, MAX_BITS - start);
+        bool set = (i % 2) == 0;
+
+        if (set) {
+            bitmap_set_consecutive(map, start, n);
+        } else {
+            bitmap_clear_consecutive(map, start, n);
+        }
+
+        for (size_t bit = 0; bit < MAX_BITS; bit++) {
+            bool in_range = (bit >= start) && (bit < (start + n));
+            unsigned exp = in_range ? (set ? 1U : 0U) : bitmap_get(ref, bit);
+            CHECK(bitmap_get(map, bit) == exp, "%s_consecutive start %zu n %zu: bit %zu",
+                set ? "set" : "clear", start, n, bit);
+        }
+    }
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < (sizeof(sizes) / sizeof(sizes[0])); i++) {
+        for (size_t j = 0; j < (sizeof(densities) / sizeof(densities[0])); j++) {
+            fill_map(sizes[i], densities[j]);
+            test_search(sizes[i]);
+        }
+    }
+
+    test_set_clear();
+
+    return test_result("bitmap");
+}
@@ -0,0 +1,188 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <test.h>
+#include <mem.h>
+
+/**
+ * Runs random sequences of allocations, aligned allocations, reservations of arbitrary ranges and
+ * frees on the buddy allocator of a page pool which is not aligned to any large block, the way
+ * pp_alloc and the reservation and free paths drive it. After each operation, the buddy free
+ * blocks must exactly cover the free pages of the pool bitmap, and be fully coalesced.
+ */
+
+#define POOL_PAGES (5000)
+#define POOL_PFN   (0x80000 + 3)
+#define MAX_ALLOCS (512)
+#define OPS        (20000)
+
+static BITMAP_ALLOC(pool_bitmap, POOL_PAGES);
+static uint8_t coverage[POOL_PAGES];
+
+static struct page_pool pool;
+
+static struct {
+    size_t index;
+    size_t num_pages;
+} allocs[MAX_ALLOCS];
+static size_t alloc_num;
+
+static void check_buddy(const char* op)
+{
+    size_t pool_pfn = pool.base / PAGE_SIZE;
+    size_t free_pages = 0;
+
+    for (size_t i = 0; i < POOL_PAGES; i++) {
+        coverage[i] = 0;
+    }
+
+    for (size_t order = 0; order <= PP_BUDDY_MAX_ORDER; order++) {
+        size_t first = pool_pfn >> order;
+        for (size_t bit = 0; bit < pool.buddy.len[order]; bit++) {
+            if (!bitmap_get(pool.buddy.free[order], bit)) {
+                continue;
+            }
+            size_t pfn = (first + bit) << order;
+            size_t pages = 1UL << order;
+            CHECK((pfn >= pool_pfn) && ((pfn + pages) <= (pool_pfn + POOL_PAGES)),
+                "%s: order %zu block at pfn 0x%zx out of the pool", op, order, pfn);
+            if ((pfn < pool_pfn) || ((pfn + pages) > (pool_pfn + POOL_PAGES))) {
+                continue;
+            }
+            for (size_t i = pfn - pool_pfn; i < (pfn - pool_pfn + pages); i++) {
+                coverage[i]++;
+            }
+            free_pages += pages;
+
+            size_t buddy = (first + bit) ^ 1;
+            if ((order < PP_BUDDY_MAX_ORDER) && (buddy >= first) &&
+                ((buddy - first) < pool.buddy.len[order])) {
+                CHECK(!bitmap_get(pool.buddy.free[order], buddy - first),
+                    "%s: order %zu buddies at pfn 0x%zx not coalesced", op, order, pfn);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < POOL_PAGES; i++) {
+        unsigned exp = bitmap_get(pool.bitmap, i) ? 0 : 1;
+        CHECK(coverage[i] == exp, "%s: page %zu is %s but covered by %u free blocks", op, i,
+            exp ? "free" : "allocated", coverage[i]);
+    }
+
+    CHECK(free_pages == pool.free, "%s: %zu free pages in blocks, %zu in the pool", op, free_pages,
+        pool.free);
+}
+
+static size_t order_of(size_t num_pages)
+{
+    size_t order = 0;
+    while ((1UL << order) < num_pages) {
+        order++;
+    }
+    return order;
+}
+
+static bool has_free_block(size_t min_order)
+{
+    for (size_t order = min_order; order <= PP_BUDDY_MAX_ORDER; order++) {
+        if (bitmap_find_next_set(pool.buddy.free[order], pool.buddy.len[order], 0) >= 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void record_alloc(size_t index, size_t num_pages)
+{
+    allocs[alloc_num].index = index;
+    allocs[alloc_num].num_pages = num_pages;
+    alloc_num++;
+    pool.free -= num_pages;
+}
+
+static void op_alloc(void)
+{
+    bool aligned = (test_rand() % 4) == 0;
+    size_t num_pages = aligned ? (1UL << test_rand_below(9)) : (1 + test_rand_below(300));
+    size_t index;
+
+    if (pp_buddy_alloc(&pool, num_pages, aligned, &index)) {
+        CHECK((index + num_pages) <= POOL_PAGES, "alloc %zu pages out of the pool at %zu",
+            num_pages, index);
+        CHECK(bitmap_count(pool.bitmap, index, index + num_pages, true) == 0,
+            "alloc %zu pages at %zu overlaps allocated pages", num_pages, index);
+        CHECK(!aligned || ((((pool.base / PAGE_SIZE) + index) % num_pages) == 0),
+            "aligned alloc %zu pages at %zu is not aligned", num_pages, index);
+        bitmap_set_consecutive(pool.bitmap, index, num_pages);
+        record_alloc(index, num_pages);
+    } else {
+        CHECK(!has_free_block(order_of(num_pages)), "alloc %zu pages failed with free blocks",
+            num_pages);
+    }
+    check_buddy("alloc");
+}
+
+static void op_reserve(void)
+{
+    size_t num_pages = 1 + test_rand_below(200);
+    size_t index = test_rand_below(POOL_PAGES - num_pages + 1);
+
+    /* As when reserving the hypervisor or vm images, the range must be free */
+    if (bitmap_count(pool.bitmap, index, index + num_pages, true) != 0) {
+        return;
+    }
+    pp_mark_pages(&pool, index, num_pages, true);
+    record_alloc(index, num_pages);
+    check_buddy("reserve");
+}
+
+static void op_free(void)
+{
+    size_t i = test_rand_below(alloc_num);
+
+    pp_mark_pages(&pool, allocs[i].index, allocs[i].num_pages, false);
+    pool.free += allocs[i].num_pages;
+    allocs[i] = allocs[--alloc_num];
+    check_buddy("free");
+}
+
+int main(void)
+{
+    pool.base = (paddr_t)POOL_PFN * PAGE_SIZE;
+    pool.size = POOL_PAGES;
+    pool.free = POOL_PAGES;
+    pool.bitmap = pool_bitmap;
+
+    void* maps = calloc(1, pp_buddy_size(&pool));
+    void* init_maps = calloc(1, pp_buddy_size(&pool));
+    if ((maps == NULL) || (init_maps == NULL)) {
+        return EXIT_FAILURE;
+    }
+    pp_buddy_init(&pool, maps);
+    check_buddy("init");
+    __builtin_memcpy(init_maps, maps, pp_buddy_size(&pool));
+
+    for (size_t i = 0; i < OPS; i++) {
+        uint64_t op = test_rand_below(10);
+        if ((alloc_num > 0) && ((op < 4) || (alloc_num == MAX_ALLOCS))) {
+            op_free();
+        } else if (op < 6) {
+            op_alloc();
+        } else {
+            op_reserve();
+        }
+    }
+
+    while (alloc_num > 0) {
+        op_free();
+    }
+    CHECK(__builtin_memcmp(maps, init_maps, pp_buddy_size(&pool)) == 0,
+        "pool not coalesced back to its initial blocks after freeing everything");
+
+    free(maps);
+    free(init_maps);
+
+    return test_result("buddy");
+}
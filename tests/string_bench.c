@@ -0,0 +1,104 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <test.h>
+
+/**
+ * Measures the throughput of memcpy and memset, built as test_memcpy and test_memset (see the
+ * Makefile), for the copy sizes common in the hypervisor, with the source aligned and misaligned,
+ * next to a byte at a time loop and the host's libc as references.
+ */
+
+void* test_memcpy(void* dst, const void* src, size_t count);
+void* test_memset(void* dest, int c, size_t count);
+
+#define BENCH_BYTES (UINT64_C(256) * 1024 * 1024)
+#define BUF_LEN     (64 * 1024 + 64)
+
+static uint8_t src_buf[BUF_LEN] __attribute__((aligned(4096)));
+static uint8_t dst_buf[BUF_LEN] __attribute__((aligned(4096)));
+
+static void* byte_memcpy(void* dst, const void* src, size_t count)
+{
+    volatile uint8_t* d = dst;
+    const uint8_t* s = src;
+    for (size_t i = 0; i < count; i++) {
+        d[i] = s[i];
+    }
+    return dst;
+}
+
+static void* libc_memcpy(void* dst, const void* src, size_t count)
+{
+    return __builtin_memcpy(dst, src, count);
+}
+
+static void* byte_memset(void* dest, int c, size_t count)
+{
+    volatile uint8_t* d = dest;
+    for (size_t i = 0; i < count; i++) {
+        d[i] = (uint8_t)c;
+    }
+    return dest;
+}
+
+static void* libc_memset(void* dest, int c, size_t count)
+{
+    return __builtin_memset(dest, c, count);
+}
+
+typedef void* (*memcpy_fn)(void*, const void*, size_t);
+typedef void* (*memset_fn)(void*, int, size_t);
+
+static double mib_per_s(uint64_t bytes, uint64_t ns)
+{
+    return ((double)bytes / (1024.0 * 1024.0)) / ((double)(ns ? ns : 1) / 1e9);
+}
+
+static double bench_memcpy(memcpy_fn fn, size_t len, size_t src_off)
+{
+    uint64_t iters = BENCH_BYTES / len;
+    uint64_t begin = bench_now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        bench_sink += (uintptr_t)fn(dst_buf, &src_buf[src_off], len);
+    }
+    return mib_per_s(iters * len, bench_now_ns() - begin);
+}
+
+static double bench_memset(memset_fn fn, size_t len, size_t dst_off)
+{
+    uint64_t iters = BENCH_BYTES / len;
+    uint64_t begin = bench_now_ns();
+    for (uint64_t i = 0; i < iters; i++) {
+        bench_sink += (uintptr_t)fn(&dst_buf[dst_off], (int)i, len);
+    }
+    return mib_per_s(iters * len, bench_now_ns() - begin);
+}
+
+int main(void)
+{
+    static const size_t lens[] = { 16, 64, 256, 4096, 64 * 1024 };
+    static const size_t offs[] = { 0, 3 };
+
+    printf("%-8s %6s %4s %12s %12s %12s\n", "", "len", "off", "MiB/s", "bytewise", "libc");
+    for (size_t i = 0; i < (sizeof(lens) / sizeof(lens[0])); i++) {
+        for (size_t j = 0; j < (sizeof(offs) / sizeof(offs[0])); j++) {
+            printf("%-8s %6zu %4zu %12.0f %12.0f %12.0f\n", "memcpy", lens[i], offs[j],
+                bench_memcpy(test_memcpy, lens[i], offs[j]),
+                bench_memcpy(byte_memcpy, lens[i], offs[j]),
+                bench_memcpy(libc_memcpy, lens[i], offs[j]));
+        }
+    }
+    for (size_t i = 0; i < (sizeof(lens) / sizeof(lens[0])); i++) {
+        for (size_t j = 0; j < (sizeof(offs) / sizeof(offs[0])); j++) {
+            printf("%-8s %6zu %4zu %12.0f %12.0f %12.0f\n", "memset", lens[i], offs[j],
+                bench_memset(test_memset, lens[i], offs[j]),
+                bench_memset(byte_memset, lens[i], offs[j]),
+                bench_memset(libc_memset, lens[i], offs[j]));
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
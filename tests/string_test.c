@@ -0,0 +1,122 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#include <test.h>
+
+/**
+ * Checks memcpy and memset, either the generic ones or an architecture's string.S, which are built
+ * as test_memcpy and test_memset (see the Makefile). Every combination of source and destination
+ * misalignment is tried for all lengths around the byte, word and unrolled loop thresholds, and for
+ * a few lengths spanning several pages, as taken by the block zeroing paths. Bytes around the
+ * destination range must be left untouched.
+ */
+
+void* test_memcpy(void* dst, const void* src, size_t count);
+void* test_memset(void* dest, int c, size_t count);
+
+#define GUARD     (64)
+#define MAX_OFF   (16)
+#define SMALL_LEN (300)
+#define BUF_LEN   (GUARD + MAX_OFF + (3 * 4096) + 256 + GUARD)
+
+static const size_t large_lens[] = { 511, 512, 1024, 2047, 4096, 4097, 8191, 3 * 4096 + 123 };
+static const int values[] = { 0, 0x5a, 0xff, 0x1234, -1 };
+
+static uint8_t src_buf[BUF_LEN] __attribute__((aligned(4096)));
+static uint8_t dst_buf[BUF_LEN] __attribute__((aligned(4096)));
+
+static inline uint8_t sentinel(size_t i)
+{
+    return (uint8_t)((i * 131) + 7);
+}
+
+/* Only the part of the destination buffer a call with length len might touch is used */
+static inline size_t window(size_t len)
+{
+    return GUARD + MAX_OFF + len + GUARD;
+}
+
+static void fill_dst(size_t len)
+{
+    for (size_t i = 0; i < window(len); i++) {
+        dst_buf[i] = sentinel(i);
+    }
+}
+
+/**
+ * Returns the index of the first byte of dst_buf which is not as expected, or BUF_LEN if none.
+ * Bytes in [start, start + len) are expected to be the ones from data, or fill if data is NULL.
+ */
+static size_t first_bad_byte(size_t start, size_t len, const uint8_t* data, uint8_t fill)
+{
+    for (size_t i = 0; i < window(len); i++) {
+        uint8_t exp = sentinel(i);
+        if ((i >= start) && (i < (start + len))) {
+            exp = (data != NULL) ? data[i - start] : fill;
+        }
+        if (dst_buf[i] != exp) {
+            return i;
+        }
+    }
+    return BUF_LEN;
+}
+
+static void check_memcpy(size_t dst_off, size_t src_off, size_t len)
+{
+    uint8_t* dst = &dst_buf[GUARD + dst_off];
+    uint8_t* src = &src_buf[GUARD + src_off];
+
+    fill_dst(len);
+    void* ret = test_memcpy(dst, src, len);
+
+    CHECK(ret == dst, "memcpy dst_off %zu src_off %zu len %zu returned %p", dst_off, src_off, len,
+        ret);
+    size_t bad = first_bad_byte(GUARD + dst_off, len, src, 0);
+    CHECK(bad == BUF_LEN, "memcpy dst_off %zu src_off %zu len %zu: wrong byte at %zd", dst_off,
+        src_off, len, (ssize_t)bad - (ssize_t)(GUARD + dst_off));
+}
+
+static void check_memset(size_t dst_off, int value, size_t len)
+{
+    uint8_t* dst = &dst_buf[GUARD + dst_off];
+
+    fill_dst(len);
+    void* ret = test_memset(dst, value, len);
+
+    CHECK(ret == dst, "memset dst_off %zu value 0x%x len %zu returned %p", dst_off, value, len,
+        ret);
+    size_t bad = first_bad_byte(GUARD + dst_off, len, NULL, (uint8_t)value);
+    CHECK(bad == BUF_LEN, "memset dst_off %zu value 0x%x len %zu: wrong byte at %zd", dst_off,
+        value, len, (ssize_t)bad - (ssize_t)(GUARD + dst_off));
+}
+
+int main(void)
+{
+    for (size_t i = 0; i < BUF_LEN; i++) {
+        src_buf[i] = (uint8_t)test_rand();
+    }
+
+    for (size_t dst_off = 0; dst_off < MAX_OFF; dst_off++) {
+        for (size_t src_off = 0; src_off < MAX_OFF; src_off++) {
+            for (size_t len = 0; len <= SMALL_LEN; len++) {
+                check_memcpy(dst_off, src_off, len);
+            }
+            for (size_t i = 0; i < (sizeof(large_lens) / sizeof(large_lens[0])); i++) {
+                check_memcpy(dst_off, src_off, large_lens[i]);
+            }
+        }
+
+        for (size_t v = 0; v < (sizeof(values) / sizeof(values[0])); v++) {
+            for (size_t len = 0; len <= SMALL_LEN; len++) {
+                check_memset(dst_off, values[v], len);
+            }
+            for (size_t i = 0; i < (sizeof(large_lens) / sizeof(large_lens[0])); i++) {
+                check_memset(dst_off, values[v], large_lens[i]);
+            }
+        }
+    }
+
+    return test_result("string");
+}
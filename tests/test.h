@@ -0,0 +1,70 @@
+/**
+ * SPDX-License-Identifier: Apache-2.0
+ * Copyright (c) Bao Project and Contributors. All rights reserved.
+ */
+
+#ifndef __TEST_H__
+#define __TEST_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * Minimal support for the host-side unit tests and microbenchmarks. A failed check is reported
+ * and the test keeps going. Tests return test_result() from main, so make stops on any failure.
+ */
+
+#define TEST_MAX_REPORTS (20)
+
+static unsigned long test_checks __attribute__((unused));
+static unsigned long test_failures __attribute__((unused));
+
+#define CHECK(COND, ...)                                                        \
+    do {                                                                        \
+        test_checks++;                                                          \
+        if (!(COND)) {                                                          \
+            test_failures++;                                                    \
+            if (test_failures <= TEST_MAX_REPORTS) {                            \
+                printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #COND); \
+                printf(__VA_ARGS__);                                            \
+                printf("\n");                                                   \
+            }                                                                   \
+        }                                                                       \
+    } while (0)
+
+static inline int test_result(const char* name)
+{
+    printf("%s: %lu checks, %lu failed\n", name, test_checks, test_failures);
+    return (test_failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/* Deterministic xorshift64 generator, so failures can be reproduced */
+static uint64_t test_rand_state __attribute__((unused)) = UINT64_C(0x9e3779b97f4a7c15);
+
+static inline uint64_t test_rand(void)
+{
+    test_rand_state ^= test_rand_state << 13;
+    test_rand_state ^= test_rand_state >> 7;
+    test_rand_state ^= test_rand_state << 17;
+    return test_rand_state;
+}
+
+/* Returns a random number in [0, n) */
+static inline uint64_t test_rand_below(uint64_t n)
+{
+    return (n == 0) ? 0 : (test_rand() % n);
+}
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * UINT64_C(1000000000)) + (uint64_t)ts.tv_nsec;
+}
+
+/* Results of benchmarked calls are accumulated here so they are not optimized away */
+static volatile uint64_t bench_sink __attribute__((unused));
+
+#endif /* __TEST_H__ */